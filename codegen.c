@@ -22,17 +22,20 @@
 #include "ir.h"
 #include "common.h"
 #include "diagnostic.h"
+#include "lexer.h"
 
 FILE* llvm;
 
 IR* tmp_buffer;
 uint tmpbuffer_counter = 0;
 
+// Names in the IR are interned, they are compared by pointer
+
 char* get_tmptype(char* tmp_name)
 {
 	for (uint i = 0; i < tmpbuffer_counter; i++)
 	{
-		if (strcmp(tmp_buffer[i].tmp.name, tmp_name) == 0)
+		if (tmp_buffer[i].tmp.name == tmp_name)
 			return tmp_buffer[i].tmp.type;
 	}
 
@@ -43,7 +46,7 @@ bool get_tmplokey(char* tmp_name)
 {
 	for (uint i = 0; i < tmpbuffer_counter; i++)
 	{
-		if (strcmp(tmp_buffer[i].tmp.name, tmp_name) == 0)
+		if (tmp_buffer[i].tmp.name == tmp_name)
 			return tmp_buffer[i].tmp.lo_key;
 	}
 
@@ -426,12 +429,14 @@ void parse_ir()
 				switch (ir[i].tmp.op)
 				{
 					case OP_CONST:
-						char* type = get_tmptype(ir[i].tmp.left);
+						// A literal is not looked up among the tmps
+						char* type = ir[i].tmp.const_key ? NULL : get_tmptype(ir[i].tmp.left);
 						if (type == NULL)
 						{
+							char value[32];
 							type = ir[i].tmp.type;
-							fprintf(llvm, "add %s %s, 0\n", type,
-								ir[i].tmp.left);
+							fprintf(llvm, "add %s %s, 0\n", type, !ir[i].tmp.const_key ? ir[i].tmp.left :
+								literal_text(ir[i].tmp.left, &ir[i].tmp.literal, value, sizeof(value)));
 						}
 						else
 						{
@@ -463,7 +468,7 @@ void parse_ir()
 							fprintf(llvm, "load %s, %s* ", ir[i].tmp.type,
 									ir[i].tmp.type);
 
-							if (strcmp(ir[i].scope, "global") == 0)
+							if (ir[i].scope == global_scope)
 								fprintf(llvm, "@%s\n", ir[i].tmp.left);
 							else
 								fprintf(llvm, "%%%s\n", ir[i].tmp.left);	
@@ -618,7 +623,7 @@ void parse_ir()
 
 				break;
 			case TYPE_ALLOCATE:
-				if (strcmp(ir[i].scope, "global") == 0)
+				if (ir[i].scope == global_scope)
 				{
 					if (scope)
 					{
@@ -696,7 +701,7 @@ void parse_ir()
 					fprintf(llvm, "store %s %%__storecast__%d, %s* ",
 						ir[i].store.type, storecast_counter, ir[i].store.type);
 
-					if (strcmp(ir[i].scope, "global") == 0)
+					if (ir[i].scope == global_scope)
 						fprintf(llvm, "@%s\n", ir[i].store.var_name);
 					else
 						fprintf(llvm, "%%%s\n", ir[i].store.var_name);
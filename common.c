@@ -1,19 +1,20 @@
 #include "common.h"
 #include <stdint.h>
 #include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <limits.h>
+#include <stdarg.h>
 
-int read_f(const char *fname)
-{
-    FILE *file;
-
-    if ((file = fopen(fname, "r")))
-    {
-        fclose(file);
-        return 0;
-    }
+#if defined(__AVX2__) || defined(__SSE2__)
+	#include <immintrin.h>
+#endif
 
-    return -1;
-}
+#ifndef _WIN32
+	#include <sys/mman.h>
+#endif
 
 void ar_at(_ar *ary, char* data, int index, _arsize *arsize)
 {
@@ -22,17 +23,26 @@ void ar_at(_ar *ary, char* data, int index, _arsize *arsize)
 	(*ary)[index] = data;
 }
 
-bool _isalnum(const char c)
+/*
+	Char classes for the lexer, the same as the libc checks
+	in the C locale without the calls.
+*/
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init"
+
+const uint8_t char_class[256] =
 {
-	/*
-		[a-zA-Z0-9], _
-	*/
+	['0' ... '9'] = CHAR_WORD | CHAR_DIGIT,
+	['a' ... 'z'] = CHAR_WORD,
+	['A' ... 'Z'] = CHAR_WORD,
+	['_'] = CHAR_WORD,
 
-	if(isalnum(c) || c == '_')
-		return 1;
+	[' '] = CHAR_SPACE, ['\t'] = CHAR_SPACE, ['\n'] = CHAR_SPACE,
+	['\v'] = CHAR_SPACE, ['\f'] = CHAR_SPACE, ['\r'] = CHAR_SPACE,
+};
 
-	return 0;
-}
+#pragma GCC diagnostic pop
 
 void clear_buffer(char *buffer, uint *buffer_counter)
 {
@@ -63,6 +73,533 @@ char* open_buffer(const char* source, uint *buffersize)
 	return buffer;
 }
 
+char* read_stream(int fd, uint *buffersize)
+{
+	/*
+		Fallback for pipes, stdin and
+		files that cannot be mapped
+	*/
+
+	size_t size = 0;
+	size_t capacity = 4096;
+	char* buffer = malloc(capacity + 1);
+	ssize_t count;
+
+	while ((count = read(fd, buffer + size, capacity - size)) > 0)
+	{
+		size += count;
+
+		if (size == capacity)
+		{
+			capacity *= 2;
+			buffer = realloc(buffer, capacity + 1);
+		}
+	}
+
+	if (count < 0)
+	{
+		free(buffer);
+		return NULL;
+	}
+
+	buffer[size] = '\0';
+	(*buffersize) = size;
+	return buffer;
+}
+
+char* map_buffer(const char* source, uint *buffersize)
+{
+	/*
+		Maps the file read only. "-" reads stdin.
+		The byte after the end is always '\0', so
+		scanners can look one char ahead safely.
+	*/
+
+	#ifdef _WIN32
+		return open_buffer(source, buffersize);
+	#else
+		int fd = STDIN_FILENO;
+		bool is_stdin = strcmp(source, "-") == 0;
+
+		if (!is_stdin && (fd = open(source, O_RDONLY)) < 0)
+			return NULL;
+
+		struct stat st;
+
+		if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+		{
+			size_t size = st.st_size;
+			size_t page = sysconf(_SC_PAGESIZE);
+
+			/*
+				Reserve one more page than the file needs. The tail of
+				the last file page is zero filled by the kernel and the
+				reserved page covers files ending on a page boundary.
+			*/
+
+			size_t span = (size / page + 1) * page;
+			char* region = mmap(NULL, span, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+			if (region != MAP_FAILED)
+			{
+				if (mmap(region, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) != MAP_FAILED)
+				{
+					if (!is_stdin)
+						close(fd);
+
+					(*buffersize) = size;
+					return region;
+				}
+
+				munmap(region, span);
+			}
+		}
+
+		char* buffer = read_stream(fd, buffersize);
+
+		if (!is_stdin)
+			close(fd);
+
+		if (buffer == NULL)
+			return NULL;
+
+		// Copy streams into a mapping too, so every buffer unmaps the same way
+		size_t page = sysconf(_SC_PAGESIZE);
+		size_t span = ((*buffersize) / page + 1) * page;
+		char* region = mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (region == MAP_FAILED)
+		{
+			free(buffer);
+			return NULL;
+		}
+
+		memcpy(region, buffer, *buffersize);
+		mprotect(region, span, PROT_READ);
+		free(buffer);
+		return region;
+	#endif
+}
+
+void unmap_buffer(char* buffer, uint size)
+{
+	// Releases a buffer returned by map_buffer
+	#ifdef _WIN32
+		free(buffer);
+	#else
+		size_t page = sysconf(_SC_PAGESIZE);
+		munmap(buffer, (size / page + 1) * page);
+	#endif
+}
+
+/*
+	String keyed hash table, open addressing over indexes
+	into keys/values. Keys are copied, values are not owned.
+*/
+
+void str_table_grow(str_table* table)
+{
+	table->slots_size = table->slots_size == 0 ? 64 : table->slots_size * 2;
+	free(table->slots);
+	table->slots = malloc(sizeof(uint) * table->slots_size);
+	memset(table->slots, 0xff, sizeof(uint) * table->slots_size);
+
+	for (uint i = 0; i < table->counter; i++)
+	{
+		uint slot = fnv_hash(table->keys[i], strlen(table->keys[i])) & (table->slots_size - 1);
+
+		while (table->slots[slot] != UINT_MAX)
+			slot = (slot + 1) & (table->slots_size - 1);
+
+		table->slots[slot] = i;
+	}
+}
+
+void** str_table_find(str_table* table, const char* key)
+{
+	// Pointer to the value of key, NULL if it is not in the table
+	if (table->counter == 0)
+		return NULL;
+
+	uint slot = fnv_hash(key, strlen(key)) & (table->slots_size - 1);
+
+	for (;table->slots[slot] != UINT_MAX; slot = (slot + 1) & (table->slots_size - 1))
+	{
+		if (strcmp(table->keys[table->slots[slot]], key) == 0)
+			return &table->values[table->slots[slot]];
+	}
+
+	return NULL;
+}
+
+void str_table_put(str_table* table, const char* key, void* value)
+{
+	void** found = str_table_find(table, key);
+
+	if (found != NULL)
+	{
+		(*found) = value;
+		return;
+	}
+
+	if ((table->counter + 1) * 2 > table->slots_size)
+		str_table_grow(table);
+
+	table->keys = realloc(table->keys, sizeof(char*) * (table->counter + 1));
+	table->values = realloc(table->values, sizeof(void*) * (table->counter + 1));
+	table->keys[table->counter] = strdup(key);
+	table->values[table->counter] = value;
+
+	uint slot = fnv_hash(key, strlen(key)) & (table->slots_size - 1);
+
+	while (table->slots[slot] != UINT_MAX)
+		slot = (slot + 1) & (table->slots_size - 1);
+
+	table->slots[slot] = table->counter;
+	table->counter++;
+}
+
+/*
+	Interned strings. Each distinct string is stored once, in
+	blocks that never move, and gets an id. Equal strings get
+	the same pointer, so interned names are compared with ==.
+	Id 0 is the empty string.
+*/
+
+#define INTERN_BLOCK 65536
+
+char** interned = NULL;
+uint* interned_lengths = NULL;
+uint interned_counter = 0;
+uint interned_size = 0;
+
+uint* intern_slots = NULL;
+uint intern_slots_size = 0;
+
+char* intern_block = NULL;
+uint intern_block_left = 0;
+
+char* global_scope = NULL;
+
+void intern_grow()
+{
+	intern_slots_size = intern_slots_size == 0 ? 1024 : intern_slots_size * 2;
+	free(intern_slots);
+	intern_slots = malloc(sizeof(uint) * intern_slots_size);
+	memset(intern_slots, 0xff, sizeof(uint) * intern_slots_size);
+
+	for (uint i = 0; i < interned_counter; i++)
+	{
+		uint slot = fnv_hash(interned[i], interned_lengths[i]) & (intern_slots_size - 1);
+
+		while (intern_slots[slot] != UINT_MAX)
+			slot = (slot + 1) & (intern_slots_size - 1);
+
+		intern_slots[slot] = i;
+	}
+}
+
+char* intern_store(const char* string, uint length)
+{
+	// Long strings get a block of their own, the current one is kept
+	if (length + 1 > INTERN_BLOCK / 4)
+	{
+		char* own = malloc(length + 1);
+		memcpy(own, string, length);
+		own[length] = '\0';
+		return own;
+	}
+
+	if (length + 1 > intern_block_left)
+	{
+		intern_block = malloc(INTERN_BLOCK);
+		intern_block_left = INTERN_BLOCK;
+	}
+
+	char* copy = intern_block;
+	memcpy(copy, string, length);
+	copy[length] = '\0';
+	intern_block += length + 1;
+	intern_block_left -= length + 1;
+	return copy;
+}
+
+uint intern_id(const char* string, uint length)
+{
+	if ((interned_counter + 1) * 2 > intern_slots_size)
+		intern_grow();
+
+	uint slot = fnv_hash(string, length) & (intern_slots_size - 1);
+
+	for (;intern_slots[slot] != UINT_MAX; slot = (slot + 1) & (intern_slots_size - 1))
+	{
+		uint id = intern_slots[slot];
+
+		if (interned_lengths[id] == length && memcmp(interned[id], string, length) == 0)
+			return id;
+	}
+
+	if (interned_counter == interned_size)
+	{
+		interned_size = interned_size == 0 ? 1024 : interned_size * 2;
+		interned = realloc(interned, sizeof(char*) * interned_size);
+		interned_lengths = realloc(interned_lengths, sizeof(uint) * interned_size);
+	}
+
+	interned[interned_counter] = intern_store(string, length);
+	interned_lengths[interned_counter] = length;
+	intern_slots[slot] = interned_counter;
+	return interned_counter++;
+}
+
+char* intern(const char* string)
+{
+	// intern_id can move interned, the id is taken first
+	uint id = intern_id(string, strlen(string));
+	return interned[id];
+}
+
+char* intern_format(const char* format, ...)
+{
+	char small[128];
+	va_list args;
+
+	va_start(args, format);
+	int length = vsnprintf(small, sizeof(small), format, args);
+	va_end(args);
+
+	uint id;
+
+	if (length < (int)sizeof(small))
+	{
+		id = intern_id(small, length);
+		return interned[id];
+	}
+
+	char* large = malloc(length + 1);
+	va_start(args, format);
+	vsnprintf(large, length + 1, format, args);
+	va_end(args);
+
+	id = intern_id(large, length);
+	free(large);
+	return interned[id];
+}
+
+void intern_init()
+{
+	if (interned_counter > 0)
+		return;
+
+	intern_id("", 0);
+	global_scope = intern("global");
+}
+
+uint find_any(const char* data, uint from, uint end, const char* needles, uint needles_counter)
+{
+	/*
+		Index of the first byte in [from, end) that is one of
+		the needles (at most 4), or end. With AVX2 or SSE2 a
+		whole block is compared at once; the tail and other
+		targets use the byte loop. Never reads past end.
+	*/
+
+	uint i = from;
+
+	#if defined(__AVX2__)
+		__m256i wide[4];
+
+		for (uint n = 0; n < needles_counter; n++)
+			wide[n] = _mm256_set1_epi8(needles[n]);
+
+		for (; i + 32 <= end; i += 32)
+		{
+			__m256i block = _mm256_loadu_si256((const __m256i*)(data + i));
+			__m256i hit = _mm256_cmpeq_epi8(block, wide[0]);
+
+			for (uint n = 1; n < needles_counter; n++)
+				hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(block, wide[n]));
+
+			uint mask = _mm256_movemask_epi8(hit);
+
+			if (mask != 0)
+				return i + __builtin_ctz(mask);
+		}
+	#endif
+
+	#if defined(__SSE2__)
+		__m128i narrow[4];
+
+		for (uint n = 0; n < needles_counter; n++)
+			narrow[n] = _mm_set1_epi8(needles[n]);
+
+		for (; i + 16 <= end; i += 16)
+		{
+			__m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+			__m128i hit = _mm_cmpeq_epi8(block, narrow[0]);
+
+			for (uint n = 1; n < needles_counter; n++)
+				hit = _mm_or_si128(hit, _mm_cmpeq_epi8(block, narrow[n]));
+
+			uint mask = _mm_movemask_epi8(hit);
+
+			if (mask != 0)
+				return i + __builtin_ctz(mask);
+		}
+	#endif
+
+	for (; i < end; i++)
+	{
+		for (uint n = 0; n < needles_counter; n++)
+		{
+			if (data[i] == needles[n])
+				return i;
+		}
+	}
+
+	return end;
+}
+
+#if defined(__AVX2__)
+	static inline __m256i in_range_256(__m256i block, char low, char high)
+	{
+		return _mm256_and_si256(_mm256_cmpgt_epi8(block, _mm256_set1_epi8(low - 1)),
+			_mm256_cmpgt_epi8(_mm256_set1_epi8(high + 1), block));
+	}
+
+	static inline uint class_mask_256(__m256i block, uint8_t class)
+	{
+		__m256i in;
+
+		if (class == CHAR_SPACE)
+			in = _mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(' ')),
+				in_range_256(block, '\t', '\r'));
+		else
+			in = _mm256_or_si256(_mm256_or_si256(in_range_256(block, 'a', 'z'),
+				in_range_256(block, 'A', 'Z')), _mm256_or_si256(in_range_256(block, '0', '9'),
+				_mm256_cmpeq_epi8(block, _mm256_set1_epi8('_'))));
+
+		return _mm256_movemask_epi8(in);
+	}
+#endif
+
+#if defined(__SSE2__)
+	static inline __m128i in_range_128(__m128i block, char low, char high)
+	{
+		return _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8(low - 1)),
+			_mm_cmplt_epi8(block, _mm_set1_epi8(high + 1)));
+	}
+
+	static inline uint class_mask_128(__m128i block, uint8_t class)
+	{
+		__m128i in;
+
+		if (class == CHAR_SPACE)
+			in = _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(' ')),
+				in_range_128(block, '\t', '\r'));
+		else
+			in = _mm_or_si128(_mm_or_si128(in_range_128(block, 'a', 'z'),
+				in_range_128(block, 'A', 'Z')), _mm_or_si128(in_range_128(block, '0', '9'),
+				_mm_cmpeq_epi8(block, _mm_set1_epi8('_'))));
+
+		return _mm_movemask_epi8(in);
+	}
+#endif
+
+uint skip_class(const char* data, uint from, uint end, uint8_t class)
+{
+	/*
+		Index of the first byte in [from, end) that is not in
+		class (CHAR_WORD or CHAR_SPACE), or end. Bytes over 127
+		are in no class, as in char_class.
+	*/
+
+	uint i = from;
+
+	#if defined(__AVX2__)
+		for (; i + 32 <= end; i += 32)
+		{
+			uint mask = ~class_mask_256(_mm256_loadu_si256((const __m256i*)(data + i)), class);
+
+			if (mask != 0)
+				return i + __builtin_ctz(mask);
+		}
+	#endif
+
+	#if defined(__SSE2__)
+		for (; i + 16 <= end; i += 16)
+		{
+			uint mask = ~class_mask_128(_mm_loadu_si128((const __m128i*)(data + i)), class) & 0xffff;
+
+			if (mask != 0)
+				return i + __builtin_ctz(mask);
+		}
+	#endif
+
+	for (; i < end && (char_class[(uint8_t)data[i]] & class); i++){}
+
+	return i;
+}
+
+uint index_newlines(const char* data, uint from, uint end, uint* out)
+{
+	// Newlines in [from, end), their offsets go to out if it is set
+	uint lines = 0;
+	uint i = from;
+
+	#if defined(__AVX2__)
+		for (; i + 32 <= end; i += 32)
+		{
+			uint mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+				_mm256_loadu_si256((const __m256i*)(data + i)), _mm256_set1_epi8('\n')));
+
+			for (; mask != 0 && out != NULL; mask &= mask - 1)
+				out[lines++] = i + __builtin_ctz(mask);
+
+			lines += __builtin_popcount(mask);
+		}
+	#endif
+
+	#if defined(__SSE2__)
+		for (; i + 16 <= end; i += 16)
+		{
+			uint mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+				_mm_loadu_si128((const __m128i*)(data + i)), _mm_set1_epi8('\n')));
+
+			for (; mask != 0 && out != NULL; mask &= mask - 1)
+				out[lines++] = i + __builtin_ctz(mask);
+
+			lines += __builtin_popcount(mask);
+		}
+	#endif
+
+	for (; i < end; i++)
+	{
+		if (data[i] != '\n')
+			continue;
+
+		if (out != NULL)
+			out[lines] = i;
+		lines++;
+	}
+
+	return lines;
+}
+
+uint64_t fnv_hash(const char* data, size_t size)
+{
+	// FNV-1a 64 bit
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= (unsigned char)data[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
 bool _isbinary(char value)
 {
 	if(value == '0' || value == '1')
@@ -93,11 +630,59 @@ bool isbinop (const char* value)
 
 bool is_integer(const char* c)
 {
-	for (uint i = 0; i < strlen(c); i++)
+	for (;*c != '\0'; c++)
 	{
-		if (!isdigit(c[i]) && c[i] != '.')
+		if (!isdigit(*c) && *c != '.')
 			return 0;
 	}
 
 	return 1;
 }
+
+/*
+	Phase timings for --Time
+*/
+
+typedef struct
+{
+	const char* name;
+	double ms;
+}
+phase_timing;
+
+phase_timing timings[16];
+uint timings_counter = 0;
+struct timespec phase_begin;
+
+void phase_start()
+{
+	clock_gettime(CLOCK_MONOTONIC, &phase_begin);
+}
+
+void phase_stop(const char* name)
+{
+	struct timespec phase_end;
+	clock_gettime(CLOCK_MONOTONIC, &phase_end);
+
+	if (timings_counter >= 16)
+		return;
+
+	timings[timings_counter].name = name;
+	timings[timings_counter].ms = (phase_end.tv_sec - phase_begin.tv_sec) * 1e3 +
+		(phase_end.tv_nsec - phase_begin.tv_nsec) / 1e6;
+	timings_counter++;
+}
+
+void print_timings()
+{
+	double total = 0;
+
+	printf("Time:\n");
+	for (uint i = 0; i < timings_counter; i++)
+	{
+		printf("\t%-14s %10.3f ms\n", timings[i].name, timings[i].ms);
+		total += timings[i].ms;
+	}
+
+	printf("\t%-14s %10.3f ms\n", "total", total);
+}
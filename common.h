@@ -6,28 +6,83 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef char** _ar;
 typedef uint _arsize;
 
+typedef struct
+{
+	char** keys;
+	void** values;
+	uint counter;
+
+	uint* slots;
+	uint slots_size;
+}
+str_table;
+
 typedef struct
 {
 	bool asm_flag;
 	bool obj;
 	bool llvm;
 	bool ir;
+	bool time;
+	bool deps;
+	bool legacy_lexer;
+	uint jobs;
+	char* cache_dir;
+	char** include_paths;
+	uint include_paths_counter;
 }
 arg_flags;
 
 extern arg_flags arg_flagref;
 
-int read_f(const char *fname);
+// Value of a number literal, read once by the lexer. real when it has a dot
+typedef union
+{
+	int64_t integer;
+	double real;
+}
+_literal;
+
+#define CHAR_WORD  1 // [a-zA-Z0-9_]
+#define CHAR_SPACE 2
+#define CHAR_DIGIT 4
+
+extern const uint8_t char_class[256];
+
+static inline bool _isalnum(const char c)
+{
+	return char_class[(uint8_t)c] & CHAR_WORD;
+}
+
+// Interned strings, compared by pointer. Id 0 is ""
+extern char** interned;
+extern char* global_scope;
+
 void ar_at(_ar *ary, char* data, int index, _arsize *arsize);
-bool _isalnum(const char c);
 void clear_buffer(char *buffer, uint *buffer_counter);
 char* open_buffer(const char* source, uint *buffersize);
+char* map_buffer(const char* source, uint *buffersize);
+void unmap_buffer(char* buffer, uint size);
+uint64_t fnv_hash(const char* data, size_t size);
+void** str_table_find(str_table* table, const char* key);
+void str_table_put(str_table* table, const char* key, void* value);
+void intern_init();
+uint intern_id(const char* string, uint length);
+char* intern(const char* string);
+char* intern_format(const char* format, ...);
+uint find_any(const char* data, uint from, uint end, const char* needles, uint needles_counter);
+uint skip_class(const char* data, uint from, uint end, uint8_t class);
+uint index_newlines(const char* data, uint from, uint end, uint* out);
 bool _isbinary(char value);
 bool isbinop (const char* value);
 bool is_integer(const char* c);
+void phase_start();
+void phase_stop(const char* name);
+void print_timings();
 
 #endif
@@ -31,10 +31,19 @@
 				 "		obj\n" \
 				 "		llvm\n" \
 				 "		ir\n" \
+				 "		deps (Makefile rule, not part of all)\n" \
 				 "	--Compile -c  Show the source file.\n" \
-				 "		Values: Source file name.\n" \
+				 "		Values: Source file name, - for stdin.\n" \
 				 "	--Output -o   Show the output file name.\n" \
 				 "		Values: Output file name\n" \
+				 "	--Time -t     Print the time spent in each phase.\n" \
+				 "	--Include -I  Add a directory to search for include files.\n" \
+				 "		Values: Directory, can be given more than once\n" \
+				 "	--Jobs -j     Threads used to load include files and lex large sources.\n" \
+				 "		Values: Thread count, 1 does both one by one.\n" \
+				 "	--cache-dir   Reuse preprocessed sources and lexed includes from this directory.\n" \
+				 "		Values: Cache directory\n" \
+				 "	--Legacy-lexer  Lex with the old byte machine, to compare tokens.\n" \
 				 "Useage: seal [information].\n" \
 				 "Options:\n" \
 				 "	--Help -h     Print this message and exit.\n" \
@@ -42,55 +51,88 @@
 
 uint tab_counter = 0;
 
-uint print_lines(const char* diag, uint line)
+/*
+	Offsets of the newlines in the expanded source. They are
+	indexed on the first diagnostic, a line is then found by
+	binary search.
+*/
+
+uint* newlines = NULL;
+uint newlines_counter = 0;
+
+void index_source()
+{
+	if (newlines != NULL)
+		return;
+
+	newlines = malloc(sizeof(uint) * (index_newlines(root_file, 0, rf_counter, NULL) + 1));
+	newlines_counter = index_newlines(root_file, 0, rf_counter, newlines);
+}
+
+// Offset of the first char of a line
+uint line_start(uint line)
 {
-	char* file = strdup(root_file);
-	uint filesize = rf_counter;
+	return line == 1 ? 0 : newlines[line - 2] + 1;
+}
+
+source_position position_at(const uint offset)
+{
+	source_position position = {0, 0};
+
+	if (offset > rf_counter)
+		return position;
+
+	index_source();
 
-	if (diag != NULL)
+	// Newlines before offset
+	uint low = 0;
+	uint high = newlines_counter;
+
+	while (low < high)
 	{
-		file = strdup(diag);
-		filesize = strlen(diag);
+		uint mid = (low + high) / 2;
+
+		if (newlines[mid] < offset)
+			low = mid + 1;
+		else
+			high = mid;
 	}
-	
-	uint c = 1;
-	for (uint i = 0; i != filesize; i++)
+
+	position.line = low + 1;
+	position.column = offset - line_start(position.line) + 1;
+	return position;
+}
+
+void print_location(uint line)
+{
+	uint file_line = 0;
+	const char* file = source_location(line, &file_line);
+
+	if (file != NULL)
+		printf("%s:%d", file, file_line);
+}
+
+uint print_lines(uint line)
+{
+	// The line before the wrong one and the wrong one, if it has any text
+	const char* file = root_file;
+	index_source();
+
+	if (line == 0 || line > newlines_counter + 1)
+		return 0;
+
+	for (uint t = line_start(line); t < rf_counter && file[t] == '\t'; t++)
+		tab_counter++;
+
+	for (uint c = line == 1 ? 1 : line - 1; c <= line && line_start(c) < rf_counter; c++)
 	{
-		if (c == line)
-		{
-			for (uint t = i; file[t] == '\t'; t++)
-				tab_counter++;
-		}
-
-		if (diag != NULL && c == line - 1)
-		{
-			for (;file[i] != '\n'; i++)
-				printf("%c", file[i]);
-			
-			return 0;
-		}
-
-		if (line == 1) 
-		{
-		    printf("\t");
-		    for (uint i = 0; file[i] != '\n' && file[i] != '\0'; i++)
-		        printf("%c", file[i]);
-		
-		    return 0;
-		}
-		
-		if (c == line - 1 || c == line)
-		{			
-			printf("\t");
-			
-			for (;file[i] != '\n'; i++)
-				printf("%c", file[i]);
+		printf("\t");
 
-			printf("\n");
-		}
+		for (uint i = line_start(c); i < rf_counter && file[i] != '\n' && file[i] != '\0'; i++)
+			printf("%c", file[i]);
 
-		if (file[i] == '\n')
-			c++;
+		if (line != 1)
+			printf("\n");
 	}
 
 	return 0;
@@ -137,20 +179,25 @@ void prep_error(const char* source_file, const uint line, const uint column, con
 		case END_SYMBOL_WRONG:
 			printf("| The '@' symbol is placed only at the end of included files.\n");
 			exit(1);
+		case DEPFILE_CANNOT_WRITE:
+			printf("| Dependency file cannot be written. Check permisson\n");
+			exit(1);
 		default:
 	}
 }
 
-void lexer_error(const uint line, const uint column, const LEXER_LAYER_ERROR_TYPE ERROR_TYPE)
+void lexer_error(const uint offset, const LEXER_LAYER_ERROR_TYPE ERROR_TYPE)
 {
+	const source_position position = position_at(offset);
+
 	printf("lexer-error~>");
-	print_lines(diagnostic_mark, line);
-	printf(":%d\n", column);
-	print_lines(NULL, line);
+	print_location(position.line);
+	printf(":%d\n", position.column);
+	print_lines(position.line);
 
-	if (line == 1)
+	if (position.line == 1)
 		printf("\n");
-	print_caret(column);
+	print_caret(position.column);
 
 	switch (ERROR_TYPE)
 	{
@@ -172,8 +219,35 @@ void lexer_error(const uint line, const uint column, const LEXER_LAYER_ERROR_TYP
 		case MULTIPLE_DOTS:
 			printf("| Multiple dots\n");
 			exit(1);
-		case IDENTIFIER_OVERFLOW:
-			printf("| Identifier name overflow. Identifier name must be 256(max) char\n");
+		default:
+			printf("| Unexpected error\n");
+			exit(1);
+	}
+}
+
+void macro_error(const uint offset, const MACRO_LAYER_ERROR_TYPE ERROR_TYPE)
+{
+	const source_position position = position_at(offset);
+
+	printf("macro-error~>");
+	print_location(position.line);
+	printf(":%d\n", position.column);
+	print_lines(position.line);
+
+	if (position.line == 1)
+		printf("\n");
+	print_caret(position.column);
+
+	switch (ERROR_TYPE)
+	{
+		case MACRO_WRONG_PARAMS:
+			printf("| Syntax error; MACRO Useage ~> DEFINE <IDENTIFIER>(<IDENTIFIER>, ...) <*> $\n");
+			exit(1);
+		case MACRO_ARGC_MISMATCH:
+			printf("| Macro argument count does not match its parameters.\n");
+			exit(1);
+		case MACRO_MISSING_RPAREN:
+			printf("| Missing ')' after macro arguments.\n");
 			exit(1);
 		default:
 			printf("| Unexpected error\n");
@@ -181,16 +255,18 @@ void lexer_error(const uint line, const uint column, const LEXER_LAYER_ERROR_TYP
 	}
 }
 
-void parser_error(const uint line, const uint column, const PARSER_LAYER_ERROR_TYPE ERROR_TYPE)
+void parser_error(const uint offset, const PARSER_LAYER_ERROR_TYPE ERROR_TYPE)
 {
+	const source_position position = position_at(offset);
+
 	printf("parser-error~>");
-	print_lines(diagnostic_mark, line);
-	printf(":%d\n", column);
-	print_lines(NULL, line);
+	print_location(position.line);
+	printf(":%d\n", position.column);
+	print_lines(position.line);
 
-	if (line == 1)
+	if (position.line == 1)
 		printf("\n");
-	print_caret(column);
+	print_caret(position.column);
 
 	switch (ERROR_TYPE)
 	{
@@ -245,23 +321,25 @@ void parser_error(const uint line, const uint column, const PARSER_LAYER_ERROR_T
 	}
 }
 
-void semantic_error(const char* source_file, const uint line, const uint column, const char* scope, const uint scpline,
-	const uint scpcolumn, const char* argument, const SEMANTIC_LAYER_ERROR_TYPE ERROR_TYPE)
+void semantic_error(const char* source_file, const uint offset, const char* scope, const uint scope_offset,
+	const char* argument, const SEMANTIC_LAYER_ERROR_TYPE ERROR_TYPE)
 {
+	const source_position position = position_at(offset);
+
 	printf("semantic-error->");
-	print_lines(diagnostic_mark, line);
-	printf(":%d:%s\n", column, scope);
+	print_location(position.line);
+	printf(":%d:%s\n", position.column, scope);
 
 	if (argument != NULL)
 		printf("         ^~~~~~> %s\n\n", argument);
 	else
 		printf("\n");
 
-	print_lines(NULL, line);
-	if (line == 1)
+	print_lines(position.line);
+	if (position.line == 1)
 		printf("\n");
 
-	print_caret(column);
+	print_caret(position.column);
 
 	switch (ERROR_TYPE)
 	{
@@ -301,9 +379,9 @@ void semantic_error(const char* source_file, const uint line, const uint column,
 void codegen_error(const uint line, const uint column, const CODEGEN_LAYER_ERROR_TYPE ERROR_TYPE)
 {
 	printf("codegen-error~>");
-	print_lines(diagnostic_mark, line);
+	print_location(line);
 	printf(":%d\n", column);
-	print_lines(NULL, line);
+	print_lines(line);
 
 	if (line == 1)
 		printf("\n");
@@ -1,12 +1,14 @@
 #ifndef DIAGNOSTIC_H
 #define DIAGNOSTIC_H
 #include <stdlib.h>
+#include <limits.h>
 
 typedef enum
 {
 	FILE_NOT_EXISTS,
 	END_SYMBOL_WRONG,
 	END_SYMBOL,
+	DEPFILE_CANNOT_WRITE,
 	NON_PREP	
 }
 PREP_LAYER_ERROR_TYPE;
@@ -18,7 +20,6 @@ typedef enum
 	IS_NOT_HEX,
 	IS_NOT_BIN,
 	IS_NOT_DECIMAL,
-	IDENTIFIER_OVERFLOW,
 	MULTIPLE_DOTS,
 	NON_LEXER,
 }
@@ -45,6 +46,15 @@ typedef enum
 }
 PARSER_LAYER_ERROR_TYPE;
 
+typedef enum
+{
+	MACRO_WRONG_PARAMS,
+	MACRO_ARGC_MISMATCH,
+	MACRO_MISSING_RPAREN,
+	NON_MACRO
+}
+MACRO_LAYER_ERROR_TYPE;
+
 typedef enum
 {
 	FILE_NOT_OPEN,
@@ -74,15 +84,33 @@ typedef enum
 } 
 CODEGEN_LAYER_ERROR_TYPE;
 
+/*
+	Tokens and nodes keep where they are as an offset in the
+	expanded source. Line and column are only worked out of it
+	when a diagnostic needs them.
+*/
+
+typedef struct
+{
+	uint line;
+	uint column;
+}
+source_position;
+
+#define NO_POSITION UINT_MAX // line and column 0
+
+source_position position_at(const uint offset);
+
 void cli_error(const char* error_out);
 void prep_error(const char* source_file, const uint line,
 				const uint column, const PREP_LAYER_ERROR_TYPE ERROR_TYPE);
 
-void semantic_error(const char* source_file, const uint line, const uint column, const char* scope, const uint scpline,
-					const uint scpcolumn, const char* argument, const SEMANTIC_LAYER_ERROR_TYPE ERROR_TYPE);
+void semantic_error(const char* source_file, const uint offset, const char* scope, const uint scope_offset,
+					const char* argument, const SEMANTIC_LAYER_ERROR_TYPE ERROR_TYPE);
 
-void lexer_error(const uint line, const uint column, const LEXER_LAYER_ERROR_TYPE ERROR_TYPE);
-void parser_error(const uint line, const uint column, const PARSER_LAYER_ERROR_TYPE ERROR_TYPE);
+void lexer_error(const uint offset, const LEXER_LAYER_ERROR_TYPE ERROR_TYPE);
+void macro_error(const uint offset, const MACRO_LAYER_ERROR_TYPE ERROR_TYPE);
+void parser_error(const uint offset, const PARSER_LAYER_ERROR_TYPE ERROR_TYPE);
 void ir_error(const uint line, const uint column, const IR_LAYER_ERROR_TYPE ERROR_TYPE);
 void codegen_error(const uint line, const uint column, const CODEGEN_LAYER_ERROR_TYPE ERROR_TYPE);
 
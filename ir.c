@@ -1,7 +1,7 @@
 #include "parser.h"
 #include "ir.h"
 #include "semantic.h"
-#include <limits.h>
+#include "lexer.h"
 #include <string.h>
 
 uint tmp_counter = 0;
@@ -17,7 +17,7 @@ bool is_arg(char* arg)
 {
 	for (uint c = 0; c < current_func.func.argc; c++)
 	{
-		if (strcmp(current_func.func.args[c].name, arg) == 0)
+		if (current_func.func.args[c].name == arg)
 			return 1;
 	}
 
@@ -29,7 +29,7 @@ void emit_ret(char* type, char* value)
 	char* val = NULL;
 
 	if (is_arg(value))
-		asprintf(&val, "%s__addr__", value);
+		val = intern_format("%s__addr__", value);
 	else
 		val = value;
 
@@ -46,14 +46,14 @@ void emit_tmp_singleop(OP_TYPE optype, char* type, char* name, char* left, char*
 {
 	char* left_val = NULL;
 	if (left != NULL && is_arg(left))
-		asprintf(&left_val, "%s__addr__", left);
+		left_val = intern_format("%s__addr__", left);
 	else
 		left_val = left;
 
 	char* right_val = NULL;
 
 	if (right != NULL && is_arg(right))
-		asprintf(&right_val, "%s__addr__", right);
+		right_val = intern_format("%s__addr__", right);
 	else
 		right_val = right;
 
@@ -66,17 +66,24 @@ void emit_tmp_singleop(OP_TYPE optype, char* type, char* name, char* left, char*
 	ir[ir_counter].tmp.lo_key = lo_key;
 	ir[ir_counter].tmp.size = size;
 
-	if (right != NULL)
-		ir[ir_counter].tmp.right = right_val;
+	ir[ir_counter].tmp.right = right_val;
 	if (global_key)
-		ir[ir_counter].scope = "global";
+		ir[ir_counter].scope = global_scope;
 	else
 		ir[ir_counter].scope = general_scope;
 
 	ir[ir_counter].tmp.op = optype;
+	ir[ir_counter].tmp.const_key = 0;
 	ir_counter++;
 }
 
+void emit_literal(char* type, char* name, expr_id e)
+{
+	emit_tmp_singleop(OP_CONST, type, name, expr_text[e], NULL, NULL, NULL, 0, 0);
+	ir[ir_counter - 1].tmp.const_key = 1;
+	ir[ir_counter - 1].tmp.literal = *expr_value(e);
+}
+
 void emit_call(char* tmp, char* callee, char* type, arg* args, uint argc)
 {
 	arg* args_val = malloc(sizeof(arg) * argc);
@@ -86,7 +93,7 @@ void emit_call(char* tmp, char* callee, char* type, arg* args, uint argc)
 		if (is_arg(args[i].name))
 		{
 			char* arg_addr = NULL;
-			asprintf(&arg_addr, "%s__addr__", args[i].name);
+			arg_addr = intern_format("%s__addr__", args[i].name);
 			args_val[i].name = arg_addr;
 			args_val[i].type = args[i].type;
 			continue;
@@ -109,7 +116,7 @@ void emit_call(char* tmp, char* callee, char* type, arg* args, uint argc)
 		ir[ir_counter].tmp.args = args_val;
 
 	ir[ir_counter].tmp.argc = argc;
-	ir[ir_counter].scope = "global";
+	ir[ir_counter].scope = global_scope;
 	ir[ir_counter].tmp.lo_key = 0;
 	ir[ir_counter].tmp.op = OP_CALL;
 	ir[ir_counter].tmp.left = NULL;
@@ -126,7 +133,7 @@ void emit_alloc(char* var_name, char* type, bool global_key, char* size)
 	ir[ir_counter].allocate.size = size;
 	
 	if (global_key)
-		ir[ir_counter].scope = "global";
+		ir[ir_counter].scope = global_scope;
 	else
 		ir[ir_counter].scope = general_scope;
 
@@ -146,7 +153,7 @@ void emit_jumper(char* condition, char* label)
 {
 	char* val = NULL;
 	if (is_arg(condition))
-		asprintf(&val, "%s__addr__", condition);
+		val = intern_format("%s__addr__", condition);
 	else
 		val = condition;
 
@@ -161,7 +168,7 @@ void emit_store(char* var_name, char* type, char* value, char* size, bool global
 {
 	char* val = NULL;
 	if (is_arg(var_name))
-		asprintf(&val, "%s__addr__", var_name);
+		val = intern_format("%s__addr__", var_name);
 	else
 		val = var_name;
 		
@@ -174,7 +181,7 @@ void emit_store(char* var_name, char* type, char* value, char* size, bool global
 	ir[ir_counter].store.size = size;
 
 	if (global_key)
-		ir[ir_counter].scope = "global";
+		ir[ir_counter].scope = global_scope;
 	else
 		ir[ir_counter].scope = general_scope;
 
@@ -187,8 +194,7 @@ bool is_local(char* var_name)
 	{
 		if (ir[i].type == TYPE_ALLOCATE)
 		{
-			if (strcmp(ir[i].allocate.var_name, var_name) == 0 && 
-			strcmp(ir[i].scope, "global") == 0)
+			if (ir[i].allocate.var_name == var_name && ir[i].scope == global_scope)
 			{
 				return 0;
 			}
@@ -202,8 +208,8 @@ char* get_vartype(char* var_name)
 {
 	for (uint i = 0; i < var_counter; i++)
 	{
-		if (strcmp(var_buffer[i].var.name, var_name) == 0 && 
-			(strcmp(var_buffer[i].scope, general_scope) == 0 || strcmp(var_buffer[i].scope, "global") == 0))
+		if (var_buffer[i].var.name == var_name && 
+			(var_buffer[i].scope == general_scope || var_buffer[i].scope == global_scope))
 			return var_buffer[i].var.type;
 	}
 
@@ -214,7 +220,7 @@ char* get_functype(char* function_name)
 {
 	for (uint i = 0; i < function_counter; i++)
 	{
-		if (strcmp(function_buffer[i].var.name, function_name) == 0)
+		if (function_buffer[i].var.name == function_name)
 			return function_buffer[i].var.type;
 	}
 
@@ -225,7 +231,7 @@ char* get_argtype(char* function_name, uint index)
 {
 	for (uint i = 0; i < function_counter; i++)
 	{
-		if (strcmp(function_buffer[i].var.name, function_name) == 0)
+		if (function_buffer[i].var.name == function_name)
 		{
 			uint c = 0;
 			for (;c != index; c++){}
@@ -236,81 +242,59 @@ char* get_argtype(char* function_name, uint index)
 	return NULL;
 }
 
-char* type_control(const char* str)
-{
-	if (strchr(str, '.') || strchr(str, 'e') || strchr(str, 'E'))
-	{
-		const double d = strtod(str, NULL);
-		const float f = (float)d;
-
-		if ((double)f == d)
-			return "float";
-		return "double";
-	}
-	const long long val = atoll(str);
-
-	if (val >= SCHAR_MIN && val <= SCHAR_MAX)
-		return "i8";
-	else if (val >= SHRT_MIN && val <= SHRT_MAX)
-		return "i16";
-	else if (val >= INT_MIN && val <= INT_MAX)
-		return "i32";
-	return "i64";
-}
-
 typedef struct
 {
 	char* name;
-	EXPR** dims;
+	expr_id dims; // first in expr_items
 	uint dimc; 
 }
 array;
 char* use_array(array ary);
 
 FILE* ir_source;
-char* expr(EXPR* e)
+char* expr(expr_id e)
 {
-	if (!e)
+	if (e == NO_EXPR)
 		return NULL;
 
-	switch (e->type)
+	switch (expr_type(e))
 	{
 		case NODE_INT_LITERAL:
 		{
 			char* result_literal = NULL;
-			asprintf(&result_literal, "t%d", tmp_counter);
+			result_literal = intern_format("t%d", tmp_counter);
 			fprintf(ir_source, "tmp t%d const", tmp_counter);
 
-			if (!isdigit(e->literal[0]))
+			// Hex and binary literals are written from their value
+			char radix[32];
+			const char* value = literal_text(expr_text[e], expr_value(e), radix, sizeof(radix));
+
+			if (!isdigit(expr_text[e][0]))
 			{
 				switch (ir[ir_counter - 1].type)
 				{
 					case TYPE_TMP:
 						fprintf(ir_source, " %s %s", ir[ir_counter - 1].tmp.type, 
-							e->literal);
-						emit_tmp_singleop(OP_CONST, ir[ir_counter - 1].tmp.type,
-							result_literal, e->literal, NULL, NULL, NULL, 0, 0);
+							value);
+						emit_literal(ir[ir_counter - 1].tmp.type, result_literal, e);
 						break;
 					case TYPE_ALLOCATE:
 						fprintf(ir_source, " %s %s", ir[ir_counter - 1].allocate.type, 
-							e->literal);
-						emit_tmp_singleop(OP_CONST, ir[ir_counter - 1].allocate.type,
-							result_literal, e->literal, NULL, NULL, NULL, 0, 0);
+							value);
+						emit_literal(ir[ir_counter - 1].allocate.type, result_literal, e);
 						break;
 					case TYPE_STORE:
 						fprintf(ir_source, " %s %s", ir[ir_counter - 1].store.type, 
-							e->literal);
-						emit_tmp_singleop(OP_CONST, ir[ir_counter - 1].store.type,
-							result_literal, e->literal, NULL, NULL, NULL, 0, 0);
+							value);
+						emit_literal(ir[ir_counter - 1].store.type, result_literal, e);
 						break;
 					default:
 				}
 			}
 			else
 			{
-				fprintf(ir_source, " %s i64\n", e->literal);
-				emit_tmp_singleop(OP_CONST, "i64", result_literal, 
-					e->literal, NULL, NULL, NULL, 0, 0);
+				fprintf(ir_source, " %s i64\n", value);
+				emit_literal("i64", result_literal, e);
 			}
 
 			tmp_counter++;
@@ -320,19 +304,19 @@ char* expr(EXPR* e)
 		case NODE_ARRAY:
 		{
 			array current;
-			current.name = e->array.name;
-			current.dims = e->array.dims;
-			current.dimc = e->array.dimc;
+			current.name = expr_text[e];
+			current.dims = expr_left[e];
+			current.dimc = expr_right[e];
 			char* size = use_array(current);
 
 			char* result_identifier = NULL;
-			asprintf(&result_identifier, "t%d", tmp_counter);
-			char* type = get_vartype(e->array.name);
+			result_identifier = intern_format("t%d", tmp_counter);
+			char* type = get_vartype(expr_text[e]);
 
 			fprintf(ir_source, "tmp t%d load %s %s\n", 
-				tmp_counter, type, e->array.name);
+				tmp_counter, type, expr_text[e]);
 			emit_tmp_singleop(OP_LOAD, type, result_identifier,
-				e->identifier, NULL, size, "load", 0, 0);
+				expr_text[e], NULL, size, "load", 0, 0);
 			tmp_counter++;
 			return result_identifier;
 		}
@@ -340,22 +324,22 @@ char* expr(EXPR* e)
 		case NODE_IDENTIFIER:
 		{
 			char* result_identifier = NULL;
-			asprintf(&result_identifier, "t%d", tmp_counter);
-			char* type = get_vartype(e->identifier);
+			result_identifier = intern_format("t%d", tmp_counter);
+			char* type = get_vartype(expr_text[e]);
 
-			if (is_local(e->identifier) == 0)
+			if (is_local(expr_text[e]) == 0)
 			{
 				fprintf(ir_source, "tmp t%d load %s @%s\n",
-					tmp_counter, type, e->identifier);
+					tmp_counter, type, expr_text[e]);
 				emit_tmp_singleop(OP_LOAD, type, result_identifier, 
-					e->identifier, NULL, NULL, "load", 0, 1);
+					expr_text[e], NULL, NULL, "load", 0, 1);
 			}
 			else
 			{
 				fprintf(ir_source, "tmp t%d load %s %s\n", 
-					tmp_counter, type, e->identifier);
+					tmp_counter, type, expr_text[e]);
 				emit_tmp_singleop(OP_LOAD, type, result_identifier,
-					e->identifier, NULL, NULL, "load", 0, 0);
+					expr_text[e], NULL, NULL, "load", 0, 0);
 			}
 
 			tmp_counter++;
@@ -366,13 +350,13 @@ char* expr(EXPR* e)
 		{
 			char* result_binary = NULL;
 
-			char* left = expr(e->binary.left);
+			char* left = expr(expr_left[e]);
 			if (left == NULL)
-				asprintf(&left, "t%d", tmp_counter - 1);
+				left = intern_format("t%d", tmp_counter - 1);
 
-			char* right = expr(e->binary.right);
+			char* right = expr(expr_right[e]);
 			if (right == NULL)
-				asprintf(&right, "t%d", tmp_counter - 1);
+				right = intern_format("t%d", tmp_counter - 1);
 
 			char* oper = NULL;
 			OP_TYPE _oper;
@@ -380,91 +364,91 @@ char* expr(EXPR* e)
 			char* type = ir[ir_counter - 1].tmp.type;
 			bool lo_key = 0;
 
-			if (strcmp(e->binary.op, "*") == 0) 
+			if (strcmp(expr_text[e], "*") == 0) 
 			{
 				oper = "mul";
 				_oper = OP_MUL;
 			}
 
-			if (strcmp(e->binary.op, "%") == 0) 
+			if (strcmp(expr_text[e], "%") == 0) 
 			{
 				oper = "srem";
 				_oper = OP_MOD;
 			}
 
-			if (strcmp(e->binary.op, "/") == 0) 
+			if (strcmp(expr_text[e], "/") == 0) 
 			{
 				oper = "sdiv";
 				_oper = OP_DIV;
 			}
 
-			if (strcmp(e->binary.op, "-") == 0) 
+			if (strcmp(expr_text[e], "-") == 0) 
 			{
 				oper = "sub";
 				_oper = OP_SUB;
 			}
 
-			if (strcmp(e->binary.op, "+") == 0) 
+			if (strcmp(expr_text[e], "+") == 0) 
 			{
 				oper = "add";
 				_oper = OP_ADD;
 			}
 
-			if (strcmp(e->binary.op, "&&") == 0)
+			if (strcmp(expr_text[e], "&&") == 0)
 			{
 				oper = "and";
 				_oper = OP_AND;
 			}
 
-			if (strcmp(e->binary.op, "||") == 0)
+			if (strcmp(expr_text[e], "||") == 0)
 			{
 				oper = "or";
 				_oper = OP_OR;
 			}
 
-			if (strcmp(e->binary.op, "==") == 0) 
+			if (strcmp(expr_text[e], "==") == 0) 
 			{
 				oper = "icmp eq";
 				_oper = OP_CMP_EQ;
 				lo_key = 1;
 			}
 
-			if (strcmp(e->binary.op, "!=") == 0) 
+			if (strcmp(expr_text[e], "!=") == 0) 
 			{
 				oper = "icmp ne";
 				_oper = OP_CMP_NE;
 				lo_key = 1;
 			}
 
-			if (strcmp(e->binary.op, ">") == 0) 
+			if (strcmp(expr_text[e], ">") == 0) 
 			{
 				oper = "icmp sgt";
 				_oper = OP_CMP_GT;
 				lo_key = 1;
 			}
 
-			if (strcmp(e->binary.op, "<") == 0) 
+			if (strcmp(expr_text[e], "<") == 0) 
 			{
 				oper = "icmp slt";
 				_oper = OP_CMP_LT;
 				lo_key = 1;
 			}
 
-			if (strcmp(e->binary.op, ">=") == 0) 
+			if (strcmp(expr_text[e], ">=") == 0) 
 			{
 				oper = "icmp sge";
 				_oper = OP_CMP_GE;
 				lo_key = 1;
 			}
 
-			if (strcmp(e->binary.op, "<=") == 0) 
+			if (strcmp(expr_text[e], "<=") == 0) 
 			{
 				oper = "icmp sle";
 				_oper = OP_CMP_LE;
 				lo_key = 1;
 			}
 
-			asprintf(&result_binary, "t%d", tmp_counter);
+			result_binary = intern_format("t%d", tmp_counter);
 			fprintf(ir_source, "tmp %s t%d %s", type, tmp_counter, oper);
 			fprintf(ir_source, " %s", left);
 			fprintf(ir_source, " %s\n", right);
@@ -476,10 +460,10 @@ char* expr(EXPR* e)
 
 		case NODE_UNARY:
 		{
-			char* unary_value = expr(e->unary.value);
+			char* unary_value = expr(expr_left[e]);
 			char* result_unary = NULL;
 
-			asprintf(&result_unary, "t%d", tmp_counter);
+			result_unary = intern_format("t%d", tmp_counter);
 			fprintf(ir_source, "tmp t%d neg %s\n", tmp_counter, unary_value);
 			emit_tmp_singleop(OP_NEG, ir[ir_counter - 1].tmp.type, result_unary, 
 				NULL, unary_value, NULL, NULL, 0, 0);
@@ -489,10 +473,10 @@ char* expr(EXPR* e)
 
 		case NODE_NOT:
 		{
-			char* not_value = expr(e->unary.value);
+			char* not_value = expr(expr_left[e]);
 			char* result_not = NULL;
 
-			asprintf(&result_not, "t%d", tmp_counter);
+			result_not = intern_format("t%d", tmp_counter);
 			emit_tmp_singleop(OP_NOT, ir[ir_counter - 1].tmp.type, result_not,
 				not_value, NULL, NULL, NULL, 0, 0);
 			fprintf(ir_source, "tmp %s not %s %s\n", result_not, 
@@ -505,23 +489,23 @@ char* expr(EXPR* e)
 		case NODE_CALL:
 		{
 			char* result_call = NULL;
-			arg* args = malloc(sizeof(arg) * e->call.argc);
-			char* type = get_functype(e->call.callee);
+			arg* args = malloc(sizeof(arg) * expr_right[e]);
+			char* type = get_functype(expr_text[e]);
 
-			for (uint i = 0; i < e->call.argc; i++)
+			for (uint i = 0; i < expr_right[e]; i++)
 			{
-				args[i].name = expr(e->call.args[i]);
-				args[i].type = get_argtype(e->call.callee, i);
+				args[i].name = expr(expr_item(expr_left[e], i));
+				args[i].type = get_argtype(expr_text[e], i);
 			}
-			fprintf(ir_source, "tmp t%d %s call %s", tmp_counter, type, e->call.callee);
+			fprintf(ir_source, "tmp t%d %s call %s", tmp_counter, type, expr_text[e]);
 
 			fprintf(ir_source, "(");
-			for (uint i = 0; i < e->call.argc; i++)
+			for (uint i = 0; i < expr_right[e]; i++)
 				fprintf(ir_source, " %s:%s", args[i].name, args[i].type);
 			fprintf(ir_source, ")\n");
 
-			asprintf(&result_call, "t%d", tmp_counter);
-			emit_call(result_call, e->call.callee, type, args, e->call.argc);
+			result_call = intern_format("t%d", tmp_counter);
+			emit_call(result_call, expr_text[e], type, args, expr_right[e]);
 			tmp_counter++;
 			return result_call;
 		}
@@ -538,19 +522,19 @@ char* use_array(array ary)
 
 	for (uint c = 0; c != ary.dimc; c++)
 	{
-		char* current = expr(ary.dims[c]);
+		char* current = expr(expr_item(ary.dims, c));
 
 		if (ary.dimc == 1)
 			return current;
 
 		char* dim_value = NULL;
 		char* tdim = NULL;
-		asprintf(&tdim, "t%d", tmp_counter);
+		tdim = intern_format("t%d", tmp_counter);
 		tmp_counter++;
 
 		if (c == 0)
 		{
-			asprintf(&dim_value, "t%s_%d", ary.name, index_counter);
+			dim_value = intern_format("t%s_%d", ary.name, index_counter);
 			index_counter++;
 			emit_tmp_singleop(OP_MUL, "i64", tdim,
 				dim_value, current, NULL, "mul", 0, 0);
@@ -566,9 +550,9 @@ char* use_array(array ary)
 				return size;
 			}
 
-			asprintf(&dim_value, "t%s_%d", ary.name, index_counter);
+			dim_value = intern_format("t%s_%d", ary.name, index_counter);
 			index_counter++;
-			asprintf(&tdim, "t%d", tmp_counter);
+			tdim = intern_format("t%d", tmp_counter);
 			tmp_counter++;
 			emit_tmp_singleop(OP_MUL, "i64", tdim, ir[ir_counter - 1].tmp.name, 
 				dim_value, NULL, "mul", 0, 0);
@@ -592,7 +576,7 @@ void ir_main()
 		{
 			case FUNCTION:
 			{
-				if (!return_key && strcmp(ast[i - 1].scope, "global") != 0)
+				if (!return_key && ast[i - 1].scope != global_scope)
 					emit_ret("i8", "0");
 
 				fprintf(ir_source, "func %s:%s ", ast[i].function.type,
@@ -616,7 +600,7 @@ void ir_main()
 					fprintf(ir_source, " %s:%s", ast[i].function.args[l].name,
 						ast[i].function.args[l].type);
 					char* arg = NULL;
-					asprintf(&arg, "%s__addr__", ast[i].function.args[l].name);
+					arg = intern_format("%s__addr__", ast[i].function.args[l].name);
 
 					arg_addr.func.args[l].type = ast[i].function.args[l].type;
 					arg_addr.func.args[l].name = arg;
@@ -658,19 +642,19 @@ void ir_main()
 				arg* args = malloc(sizeof(arg) * ast[i].call.argc);
 				char* type = get_functype(ast[i].call.callee);
 
-				for (uint i = 0; i < ast[i].call.argc; i++)
+				for (uint c = 0; c < ast[i].call.argc; c++)
 				{
-					args[i].name = expr(ast[i].call.args[i]);
-					args[i].type = get_argtype(ast[i].call.callee, i);
+					args[c].name = expr(expr_item(ast[i].call.args, c));
+					args[c].type = get_argtype(ast[i].call.callee, c);
 				}
 				fprintf(ir_source, "tmp t%d %s call %s", tmp_counter, type, ast[i].call.callee);
 
 				fprintf(ir_source, "(");
-				for (uint i = 0; i < ast[i].call.argc; i++)
-					fprintf(ir_source, " %s:%s", args[i].name, args[i].type);
+				for (uint c = 0; c < ast[i].call.argc; c++)
+					fprintf(ir_source, " %s:%s", args[c].name, args[c].type);
 				fprintf(ir_source, ")\n");
 
-				asprintf(&result_call, "t%d", tmp_counter);
+				result_call = intern_format("t%d", tmp_counter);
 				emit_call(result_call, ast[i].call.callee, type, args, ast[i].call.argc);
 				tmp_counter++;
 				break;
@@ -688,7 +672,7 @@ void ir_main()
 			case UVAR:
 			case VAR:
 			{
-				if (strcmp(ast[i].scope, "global") == 0)
+				if (ast[i].scope == global_scope)
 				{
 					fprintf(ir_source, "alloc %s %s\n", ast[i].var.name, ast[i].var.type);
 					emit_alloc(ast[i].var.name, ast[i].var.type, 1, NULL);
@@ -698,10 +682,10 @@ void ir_main()
 				char* tmp_dim = NULL;
 				for (uint c = 0; ast[i].var.dim_key && c != ast[i].var.dimc; c++)
 				{
-					char* current = expr(ast[i].var.dims[c]);
+					char* current = expr(expr_item(ast[i].var.dims, c));
 
 					char* dim_value = NULL;
-					asprintf(&dim_value, "t%s_%d", ast[i].var.name, c);
+					dim_value = intern_format("t%s_%d", ast[i].var.name, c);
 					emit_tmp_singleop(OP_CONST, ast[i].var.type, dim_value,
 						current, NULL, NULL, NULL, 0, 0);
 
@@ -712,7 +696,7 @@ void ir_main()
 					}
 
 					char* tdim = NULL;
-					asprintf(&tdim, "t%d", tmp_counter);
+					tdim = intern_format("t%d", tmp_counter);
 					tmp_counter++;
 
 					// ast[i].var.type
@@ -65,6 +65,10 @@ typedef struct
 			bool lo_key;
 			char* size;
 
+			// for a literal const, left is its text and literal its value
+			bool const_key;
+			_literal literal;
+
 			// for call node
 			char* callee;
 			uint argc;
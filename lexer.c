@@ -20,205 +20,378 @@
 
 #include "lexer.h"
 #include "diagnostic.h"
+#include "lexer_dfa.h"
+#include "preprocessor/preprocessor.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <inttypes.h>
 
 /* ======================================== TABLES ======================================== */
 
-const _symbol symbol_table[] =
-{
-	{';',  SYMBOL_SEMICOLON},
-	{',',  SYMBOL_COMMA},
-	{'(',  SYMBOL_LPAREN},
-	{')',  SYMBOL_RPAREN},
-	{'{',  SYMBOL_LBRACE},
-	{'}',  SYMBOL_RBRACE},
-	{'[',  SYMBOL_LBRACKET},
-	{']',  SYMBOL_RBRACKET},
-	{'\'', SYMBOL_SINGLE_QUOTE},
-	{'"',  SYMBOL_DOUBLE_QUOTE},
-	{'#',  KEYWORD_FUNCTION},
-	{'+',  SYMBOL_PLUS},
-	{'-',  SYMBOL_MINUS},
-	{'*',  SYMBOL_MULTIPLY},
-	{'/',  SYMBOL_DIVIDE},
-	{'%',  SYMBOL_MODULO},
-	{'=',  SYMBOL_ASSIGN},
-	{'\\', SYMBOL_BACKSLASH},
-	{':',  KEYWORD_LABEL},
-	{'$',  SYMBOL_DOLAR},
-	{'@',  END_INCFILE}
+/*
+	Symbols and operators are indexed by their first char.
+	single_operators holds the operators that are one char on
+	their own, double_operators the second char that makes a
+	two char operator out of the first one.
+*/
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init"
+
+const uint8_t symbol_table[256] =
+{
+	[0 ... 255] = SYMBOL_INVALID,
+
+	[';']  = SYMBOL_SEMICOLON,
+	[',']  = SYMBOL_COMMA,
+	['(']  = SYMBOL_LPAREN,
+	[')']  = SYMBOL_RPAREN,
+	['{']  = SYMBOL_LBRACE,
+	['}']  = SYMBOL_RBRACE,
+	['[']  = SYMBOL_LBRACKET,
+	[']']  = SYMBOL_RBRACKET,
+	['\''] = SYMBOL_SINGLE_QUOTE,
+	['"']  = SYMBOL_DOUBLE_QUOTE,
+	['#']  = KEYWORD_FUNCTION,
+	['+']  = SYMBOL_PLUS,
+	['-']  = SYMBOL_MINUS,
+	['*']  = SYMBOL_MULTIPLY,
+	['/']  = SYMBOL_DIVIDE,
+	['%']  = SYMBOL_MODULO,
+	['=']  = SYMBOL_ASSIGN,
+	['\\'] = SYMBOL_BACKSLASH,
+	[':']  = KEYWORD_LABEL,
+	['$']  = SYMBOL_DOLAR,
+	['@']  = END_INCFILE,
 };
-#define SYMBOL_TABLE_LENGTH 21
 
-const _loperator logical_operator_table[] =
+const uint8_t single_operators[256] =
 {
-	{"&&", LOPERATOR_AND},
-	{"||", LOPERATOR_OR},
-	{"!",  LOPERATOR_NOT},
+	[0 ... 255] = NON,
+
+	['!'] = LOPERATOR_NOT,
+	['<'] = ROPERATOR_LESS,
+	['>'] = ROPERATOR_GREATER,
 };
-#define LOGICAL_OPERATOR_TABLE_LENGTH 3
 
-const _roperator relational_operator_table[] =
+#pragma GCC diagnostic pop
+
+const _operator double_operators[256] =
 {
-	{"==", ROPERATOR_EQUAL},
-	{"!=", ROPERATOR_NEQUAL},
-	{"<=", ROPERATOR_LOE},
-	{">=", ROPERATOR_GOE},
-	{"<",  ROPERATOR_LESS},
-	{">",  ROPERATOR_GREATER},
+	['&'] = {'&', LOPERATOR_AND},
+	['|'] = {'|', LOPERATOR_OR},
+	['='] = {'=', ROPERATOR_EQUAL},
+	['!'] = {'=', ROPERATOR_NEQUAL},
+	['<'] = {'=', ROPERATOR_LOE},
+	['>'] = {'=', ROPERATOR_GOE},
 };
-#define RELATIONAL_OPERATOR_TABLE_LENGTH 6
-
-const _data_type data_type_table[] =
-{
-	{"i1",		  DTYPE_BINARY},
-	{"integer",   DTYPE_INTEGER},
-	{"i8",        DTYPE_INTEGER8},
-	{"i16",       DTYPE_INTEGER16},
-	{"i32",       DTYPE_INTEGER32},
-	{"i64",       DTYPE_INTEGER64},
-	{"float",     DTYPE_FLOAT},
-	{"double",    DTYPE_DOUBLE},
-	{"char",      DTYPE_CHAR},
+
+// Token types that are binary operators in expressions
+const bool binop_types[NON + 1] =
+{
+	[SYMBOL_PLUS] = 1, [SYMBOL_MINUS] = 1, [SYMBOL_MULTIPLY] = 1,
+	[SYMBOL_DIVIDE] = 1, [SYMBOL_MODULO] = 1,
+	[LOPERATOR_AND] = 1, [LOPERATOR_OR] = 1,
+	[ROPERATOR_EQUAL] = 1, [ROPERATOR_NEQUAL] = 1, [ROPERATOR_LESS] = 1,
+	[ROPERATOR_GREATER] = 1, [ROPERATOR_LOE] = 1, [ROPERATOR_GOE] = 1,
 };
-#define DATA_TYPE_TABLE_LENGTH 9
 
-const _keyword keyword_table[] =
+/*
+	Data types and keywords share one perfect hash on the last
+	char and the length of the word, so a word is classified
+	with one lookup and one memcmp. The slots must stay unique
+	when a word is added; a clash is a compile error.
+*/
+
+#define WORD_HASH(last, length) (((uint)(last) + (length) * 7) & 63)
+#define WORD_TABLE_LENGTH 64
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic error "-Woverride-init"
+
+const _word word_table[WORD_TABLE_LENGTH] =
 {
-	{"INCLUDE",  KEYWORD_INCLUDE},
-	{"DEFINE",   KEYWORD_MACRO},
-	{"return",   KEYWORD_RETURN},
-	{"jump",     KEYWORD_JUMPER},
+	[WORD_HASH('1', 2)] = {"i1",      2, DTYPE_BINARY,    DTYPE},
+	[WORD_HASH('r', 7)] = {"integer", 7, DTYPE_INTEGER,   DTYPE},
+	[WORD_HASH('8', 2)] = {"i8",      2, DTYPE_INTEGER8,  DTYPE},
+	[WORD_HASH('6', 3)] = {"i16",     3, DTYPE_INTEGER16, DTYPE},
+	[WORD_HASH('2', 3)] = {"i32",     3, DTYPE_INTEGER32, DTYPE},
+	[WORD_HASH('4', 3)] = {"i64",     3, DTYPE_INTEGER64, DTYPE},
+	[WORD_HASH('t', 5)] = {"float",   5, DTYPE_FLOAT,     DTYPE},
+	[WORD_HASH('e', 6)] = {"double",  6, DTYPE_DOUBLE,    DTYPE},
+	[WORD_HASH('r', 4)] = {"char",    4, DTYPE_CHAR,      DTYPE},
+
+	[WORD_HASH('E', 7)] = {"INCLUDE", 7, KEYWORD_INCLUDE, KEYWORD},
+	[WORD_HASH('E', 6)] = {"DEFINE",  6, KEYWORD_MACRO,   KEYWORD},
+	[WORD_HASH('n', 6)] = {"return",  6, KEYWORD_RETURN,  KEYWORD},
+	[WORD_HASH('p', 4)] = {"jump",    4, KEYWORD_JUMPER,  KEYWORD},
 };
-#define KEYWORD_TABLE_LENGTH 4
+
+#pragma GCC diagnostic pop
 
 /* ======================================== TOOLS ======================================== */
 
-_token_type query_symbol(const char lexeme)
+_token_type query_word(const char *lexeme, uint length, _token_group *group)
 {
-	for (uint i = 0; i < SYMBOL_TABLE_LENGTH; i++)
+	// Any other word is an identifier or an integer, both in the KEYWORD group
+	const _word* word = &word_table[WORD_HASH(lexeme[length - 1], length)];
+
+	if (word->length == length && memcmp(word->lexeme, lexeme, length) == 0)
+	{
+		*group = word->token_group;
+		return word->token_type;
+	}
+
+	*group = KEYWORD;
+
+	for (uint i = 0; i < length; i++)
 	{
-		if (lexeme == symbol_table[i].lexeme)
-			return symbol_table[i].token_type;
+		if (!isdigit(lexeme[i]) && lexeme[i] != '.')
+			return IDENTIFIER;
 	}
 
-	return SYMBOL_INVALID;
+	return INTEGER_LITERAL;
 }
 
-_token_type query_loperator_token(const char *lexeme, uint *i)
-{
-	// This control is for the != and ! not to overlap
-	if (strcmp(lexeme, "!=") == 0)
-		return NON;
+// Tokens point into the source, it is kept until parsing is done
+char* buffer = NULL;
+uint buffersize = 0;
+
+/*
+	Lexeme pool, for token text that is not in the source as
+	it is. Every lexeme is appended with a '\0', offset 0 is
+	the empty string. It grows while the parser runs, so text
+	that is kept past the token is interned.
+*/
 
-	char single_operant[2] = {(char)lexeme[0], '\0'};
+_Thread_local char* lexemes = NULL;
+_Thread_local uint lexemes_counter = 0;
+_Thread_local uint lexemes_size = 0;
+
+void lexeme_pool_init(uint buffersize)
+{
+	lexemes_size = buffersize / 16 + 64;
+	lexemes = malloc(lexemes_size);
+	lexemes[0] = '\0';
+	lexemes_counter = 1;
+}
 
-	for (uint c = 0; c < LOGICAL_OPERATOR_TABLE_LENGTH; c++)
+uint lexeme_push(const char* value, uint length)
+{
+	if (lexemes_counter + length + 1 > lexemes_size)
 	{
-		if (strcmp(lexeme, logical_operator_table[c].lexeme) == 0)
+		while (lexemes_counter + length + 1 > lexemes_size)
+			lexemes_size *= 2;
+
+		lexemes = realloc(lexemes, lexemes_size);
+
+		if (lexemes == NULL)
 		{
-			(*i)++;
-			return logical_operator_table[c].token_type;
+			fprintf(stderr, "Lexer realloc error");
+			exit(1);
 		}
-
-		if (strcmp(single_operant, logical_operator_table[c].lexeme) == 0)
-			return logical_operator_table[c].token_type;
 	}
 
-	return NON;
+	uint offset = lexemes_counter;
+	memcpy(lexemes + offset, value, length);
+	lexemes[offset + length] = '\0';
+	lexemes_counter += length + 1;
+	return offset;
 }
 
-_token_type query_roperator_token(const char *lexeme, uint *i)
-{
-	char single_operant[2] = {(char)lexeme[0], '\0'};
+/*
+	A step of the lexer emits up to three tokens into lexed,
+	lexer_next hands them out and runs the lexer again once
+	they are read.
+*/
 
-	for (uint c = 0; c < RELATIONAL_OPERATOR_TABLE_LENGTH; c++)
-	{
-		if (strcmp(lexeme, relational_operator_table[c].lexeme) == 0)
-		{
-			(*i)++;
-			return relational_operator_table[c].token_type;
-		}
+#define LEXED_RING 16
 
-		if (strcmp(single_operant, relational_operator_table[c].lexeme) == 0)
-			return relational_operator_table[c].token_type;
-	}
+_Thread_local _token lexed[LEXED_RING];
+_Thread_local uint lexed_positions[LEXED_RING];
+_Thread_local uint lexed_counter = 0;
+_Thread_local uint lexed_read = 0;
+
+/*
+	Large sources are split into chunks after newlines and all
+	but the first are lexed by worker threads. A worker guesses
+	its chunk starts in READ at the first column of a line with
+	nothing pending, and lexer_next checks the guess against the
+	state the lexer really reaches there. A chunk that starts in
+	a string or a block comment is lexed again serially, so the
+	tokens are always the serial ones. Include spans from the
+	preprocessor are chunks too, with --cache-dir their tokens
+	come from the token cache.
+*/
+
+#define LEXER_CHUNK_MIN (1 << 20)
 
-	return NON;
+typedef struct
+{
+	uint start;
+	uint end;
+	pthread_t thread;
+	bool started;
+
+	// Pooled text and literals are the chunk's own
+	_token* tokens;
+	uint* positions;
+	uint counter;
+	uint size;
+	char* lexemes;
+	uint lexemes_counter;
+	_literal* literals;
+	uint literals_counter;
+
+	// Where the worker stopped
+	uint state;
+	uint offset;
+	char* lexeme_buffer;
+	uint lexeme_buffer_size;
+	uint lexeme_buffer_counter;
+	uint lexeme_from;
+	bool lexeme_copied;
+
+	// Only reported if the chunk's tokens are used
+	bool failed;
+	LEXER_LAYER_ERROR_TYPE error;
+	uint error_position;
+
+	// An include span, its arrays are in a mapped entry once cached
+	bool span;
+	bool cached;
+	uint64_t key;
+	uint base; // added to source offsets of cached tokens
+	const uint* name_offsets;
+	const char* name_text;
+	uint* names; // interned ids of the entry's names, UINT_MAX until used
+	char* mapped;
+	uint mapped_size;
 }
+lexer_chunk;
+
+_Thread_local lexer_chunk* lexer_self = NULL; // set in a worker
 
-_token_type query_data_type(const char *lexeme)
+lexer_chunk* chunks = NULL;
+uint chunks_counter = 0;
+uint chunks_next = 0;
+lexer_chunk* chunk_reading = NULL;
+uint chunk_read = 0;
+uint chunk_pool = 0; // offset of its pool in lexemes
+uint chunk_literal = 0; // index of its first literal
+
+bool text_isbinop(const char* value, const uint length)
 {
-	for (uint c = 0; c < DATA_TYPE_TABLE_LENGTH; c++)
-	{
-		if (strcmp(lexeme, data_type_table[c].lexeme) == 0)
-			return data_type_table[c].token_type;
-	}
+	char text[3] = {0};
+
+	if (length > 2)
+		return 0;
 
-	return NON;
+	memcpy(text, value, length);
+	return isbinop(text);
 }
 
-_token_type query_keyword(const char *lexeme)
+// Position is the offset of the token's last char in the source
+_token* emit_slice(const _token_type tt, _token_group tg, const char* value, const uint length,
+	const uint index, const uint position)
 {
-	for (uint c = 0; c < KEYWORD_TABLE_LENGTH; c++)
-	{
-		if (strcmp(lexeme, keyword_table[c].lexeme) == 0)
-			return keyword_table[c].token_type;
-	}
+	_token* token = &lexed[index & (LEXED_RING - 1)];
+
+	if (tt == IDENTIFIER)
+		tg = _IDENTIFIER;
+
+	// Literals are checked by their text, "+" is one as well
+	if (tg == LITERAL ? text_isbinop(value, length) : binop_types[tt])
+		tg = BINARY_OP;
+	
+	token->token_type = tt;
+	token->token_group = tg;
+	token->length = length;
+
+	// Text in the source is not copied
+	token->pooled = value < buffer || value > buffer + buffersize;
+	token->offset = token->pooled ? lexeme_push(value, length) : (uint)(value - buffer);
+	token->id = 0;
 
-	if(is_integer(lexeme))
-		return INTEGER_LITERAL;
+	// Workers leave names to lexer_next, which interns them in stream order
+	if ((tg == _IDENTIFIER || tg == DTYPE) && lexer_self == NULL)
+		token->id = intern_id(value, length);
 
-	return IDENTIFIER;
+	lexed_positions[index & (LEXED_RING - 1)] = position;
+	return token;
 }
 
-void emit_token(const _token_type tt, _token_group tg, const char* value, const uint tokens_counter,
-	const uint line_counter, uint column_counter)
+_token* emit_token(const _token_type tt, _token_group tg, const char* value, const uint index,
+	const uint position)
 {
-	if (strlen(value) > 255)
-		lexer_error(line_counter, column_counter, IDENTIFIER_OVERFLOW);
-	void *tmp_tokensr = realloc(tokens, sizeof(_token) * (tokens_counter + 1));
+	return emit_slice(tt, tg, value, strlen(value), index, position);
+}
+
+/*
+	Number literals are read once, here. The value is kept in
+	literals, the id of the token is its index there.
+*/
 
-	if (tmp_tokensr == NULL)
+_Thread_local _literal* literals = NULL;
+_Thread_local uint literals_counter = 0;
+_Thread_local uint literals_size = 0;
+
+uint literal_push(const _literal* from, const uint counter)
+{
+	if (literals_counter + counter > literals_size)
 	{
-		fprintf(stderr, "Lexer realloc error");
-		exit(1);
+		while (literals_counter + counter > literals_size)
+			literals_size = literals_size == 0 ? 256 : literals_size * 2;
+
+		literals = realloc(literals, sizeof(_literal) * literals_size);
+
+		if (literals == NULL)
+		{
+			fprintf(stderr, "Lexer realloc error\n");
+			exit(1);
+		}
 	}
 
-	tokens = tmp_tokensr;
+	uint index = literals_counter;
+	memcpy(literals + index, from, sizeof(_literal) * counter);
+	literals_counter += counter;
+	return index;
+}
 
-	if (tg == KEYWORD || tg == DTYPE)
-		column_counter--;
+uint literal_read(const _token* token)
+{
+	// Digits and dots, or a 0x or 0b literal. It may be a slice of the source
+	char small[64];
+	char* text = token->length < sizeof(small) ? small : malloc(token->length + 1);
+	memcpy(text, token_text(token), token->length);
+	text[token->length] = '\0';
 
-	if ((tg == ROPERATOR || tg == LOPERATOR) && strlen(value) == 2)
-		column_counter++;
+	_literal literal;
 
-	if (tt == IDENTIFIER)
-		tg = _IDENTIFIER;
+	if (memchr(text, '.', token->length) != NULL)
+		literal.real = strtod(text, NULL);
+	else if (text[0] == '0' && (text[1] == 'x' || text[1] == 'b'))
+		literal.integer = strtoll(text + 2, NULL, text[1] == 'x' ? 16 : 2);
+	else
+		literal.integer = strtoll(text, NULL, 10);
 
-	if (isbinop(value))
-		tg = BINARY_OP;
-	
-	tokens[tokens_counter].token_type = tt;
-	tokens[tokens_counter].token_group = tg;
-	strcpy(tokens[tokens_counter].value, value);
-	tokens[tokens_counter].line = line_counter;
-	tokens[tokens_counter].column = column_counter;
-	tokens[tokens_counter].file = "test";
+	if (text != small)
+		free(text);
+
+	return literal_push(&literal, 1);
 }
 
-char* convert_decimal(char* value)
+// Text of a literal for the IR and LLVM, hex and binary literals are written in decimal
+const char* literal_text(const char* text, const _literal* literal, char* out, const uint size)
 {
-    long decimal = 0;
+	if (text[0] != '0' || (text[1] != 'x' && text[1] != 'b'))
+		return text;
 
-    if (strncmp(value, "0x", 2) == 0)
-        decimal = strtol(value + 2, NULL, 16);
-    if (strncmp(value, "0b", 2) == 0)
-        decimal = strtol(value + 2, NULL, 2);
-
-    int result_len = snprintf(NULL, 0, "%ld", decimal);
-    char* result = (char*)malloc(result_len + 1);
-    snprintf(result, result_len + 1, "%ld", decimal);
-    return result;
+	snprintf(out, size, "%" PRId64, literal->integer);
+	return out;
 }
 
 typedef enum
@@ -237,18 +410,38 @@ _buffer_mod;
 
 char* diagnostic_srcfile;
 
-char* buffer = NULL;
-uint buffersize = 0;
+_Thread_local uint lexeme_buffer_size = 32;
+_Thread_local uint lexeme_buffer_counter = 0;
+_Thread_local char* lexeme_buffer = {0};
+
+// The table machine keeps a lexeme as a slice until it is not one
+_Thread_local uint lexeme_from = 0;
+_Thread_local bool lexeme_copied = 0;
 
-uint lexeme_buffer_size = 32;
-uint lexeme_buffer_counter = 0;
-char* lexeme_buffer = {0};
+_Thread_local uint lexer_offset = 0;
+_Thread_local uint lexer_state = 0;
+_Thread_local uint lexer_stop = 0; // lexer_done once it gets here
+_Thread_local bool lexer_done = 0;
 
-_token* tokens = NULL;
+_token tokens[TOKEN_RING];
+uint token_positions[TOKEN_RING];
 uint tokens_counter = 0;
+_token token_end = {NON, 0, 0, 0, 0, 0};
 
-uint line_counter = 1;
-uint column_counter = 1;
+bool (*token_source)() = NULL;
+
+void token_push(const _token* token, const uint position)
+{
+	tokens[tokens_counter & (TOKEN_RING - 1)] = *token;
+	token_positions[tokens_counter & (TOKEN_RING - 1)] = position;
+	tokens_counter++;
+}
+
+bool token_fill(uint i)
+{
+	while (tokens_counter <= i && token_source()) {}
+	return i < tokens_counter;
+}
 
 _buffer_mod buffer_mod = READ;
 
@@ -259,71 +452,80 @@ void scan_word(_token_type *dt, const uint i)
 		or alnum(chr) is true then return true
 	*/
 
-	if (!_isalnum(buffer[i]) && (*dt = query_data_type(lexeme_buffer)) != NON)
-	{
-		emit_token(*dt, DTYPE, lexeme_buffer, tokens_counter, line_counter, column_counter);
-		clear_buffer(lexeme_buffer, &lexeme_buffer_counter);
-		tokens_counter++;
-	}
+	if (_isalnum(buffer[i]) || lexeme_buffer[0] == '\0')
+		return;
 
-	if ((!_isalnum(buffer[i]) && lexeme_buffer[0] != '\0') && *dt == NON)
-	{	
-		emit_token(query_keyword(lexeme_buffer), KEYWORD, lexeme_buffer, 
-			tokens_counter, line_counter, column_counter);
-		clear_buffer(lexeme_buffer, &lexeme_buffer_counter);
-		tokens_counter++;
-	}
+	_token_group group;
+	_token_type type = query_word(lexeme_buffer, lexeme_buffer_counter, &group);
+
+	if (group == DTYPE)
+		*dt = type;
+
+	_token* token = emit_token(type, group, lexeme_buffer, lexed_counter, i - 1);
+
+	if (type == INTEGER_LITERAL)
+		token->id = literal_read(token);
+
+	clear_buffer(lexeme_buffer, &lexeme_buffer_counter);
+	lexed_counter++;
 }
 
 void scan_operator(_token_type *lo, _token_type *ro, uint *i)
 {
-	char operator_tmp[3] = {buffer[*i], buffer[*i + 1], '\0'};
+	const uint8_t first = buffer[*i];
+	const uint8_t second = buffer[*i + 1];
 
-	if (isspace(buffer[*i + 1]))
-		operator_tmp[1] = '\0';
+	if (char_class[first] & (CHAR_WORD | CHAR_SPACE))
+		return;
 
-	if ((!_isalnum(buffer[*i]) && !isspace(buffer[*i]))
-	&& (*lo = query_loperator_token(operator_tmp, i)) != NON)
-	{
-		if (*lo == LOPERATOR_NOT) // if single char
-			operator_tmp[1] = '\0';
-		emit_token(*lo, LOPERATOR, operator_tmp, tokens_counter, line_counter, column_counter);
+	char operator_tmp[3] = {first, second, '\0'};
+	const uint position = *i;
+	_token_type type = NON;
 
-		/*
-			If lo is single char then increase
-			column position for diagnostic
-		*/
+	if (double_operators[first].second == second && second != '\0')
+	{
+		type = double_operators[first].token_type;
+		(*i)++;
+	}
+	else if ((type = single_operators[first]) != NON)
+	{
+		// A single char operator takes the space after it
+		if (second == '\0' || (char_class[second] & CHAR_SPACE))
+			(*i)++;
 
-		if (*lo != ROPERATOR_LESS && *lo != ROPERATOR_GREATER)
-			column_counter++;
-		tokens_counter++;
+		operator_tmp[1] = '\0';
 	}
 
-	if ((!_isalnum(buffer[*i]) && !isspace(buffer[*i]))
-	&& (*ro = query_roperator_token(operator_tmp, i)) != NON && *lo == NON)
-	{
-		if (*ro == ROPERATOR_LESS || *ro == ROPERATOR_GREATER) // if single char
-			operator_tmp[1] = '\0';
-		emit_token(*ro, ROPERATOR, operator_tmp, tokens_counter, line_counter, column_counter);
+	if (type == NON)
+		return;
 
-		if (*ro != ROPERATOR_LESS && *ro != ROPERATOR_GREATER)
-			column_counter++;
-		tokens_counter++;
+	if (type <= LOPERATOR_NOT)
+	{
+		*lo = type;
+		emit_token(type, LOPERATOR, operator_tmp, lexed_counter, position + strlen(operator_tmp) - 1);
 	}
+	else
+	{
+		*ro = type;
+		emit_token(type, ROPERATOR, operator_tmp, lexed_counter, position + strlen(operator_tmp) - 1);
+	}
+
+	lexed_counter++;
 }
 
 void scan_symbol(_token_type *ro, _token_type *lo, const uint i)
 {
-	if ((!_isalnum(buffer[i]) && !isspace(buffer[i])) && (*ro == NON && *lo == NON))
+	const uint8_t c = buffer[i];
+
+	if (!(char_class[c] & (CHAR_WORD | CHAR_SPACE)) && (*ro == NON && *lo == NON))
 	{
-		char symbol[2] = {buffer[i], '\0'};
+		char symbol[2] = {c, '\0'};
 
-		if (query_symbol(buffer[i]) == SYMBOL_INVALID)
-			lexer_error(line_counter, column_counter, INVALID_CHAR);
+		if (symbol_table[c] == SYMBOL_INVALID)
+			lexer_error(i, INVALID_CHAR);
 
-		emit_token(query_symbol(buffer[i]), SYMBOL, symbol, 
-			tokens_counter, line_counter, column_counter);
-		tokens_counter++;
+		emit_token(symbol_table[c], SYMBOL, symbol, lexed_counter, i);
+		lexed_counter++;
 	}
 }
 
@@ -341,7 +543,6 @@ void lexemebuffer_rcontrol()
         }
 
         lexeme_buffer = tmp;
-        free(tmp);
     }
 }
 
@@ -371,16 +572,46 @@ void read_buffer(const char* buffer, const uint i, _buffer_mod BUFFER_MOD)
 	}
 }
 
-void update_position(const uint i)
+uint skip_fast(uint i)
 {
-	// Position for diagnostic
-	column_counter++;
+	/*
+		Comment bodies, runs of spaces and the rest of an
+		identifier are passed over (filling the lexeme buffer),
+		so they are taken a block at a time. Returns the first
+		byte that needs the byte loop.
+	*/
+
+	uint next = i;
 
-	if (buffer[i] == '\n')
+	if (buffer_mod == BLOCK_PASS)
+		next = find_any(buffer, i, buffersize, "~", 1);
+
+	// A line comment ends at '\n' or turns into a block one at "/~"
+	else if (buffer_mod == PASS)
+		next = find_any(buffer, i, buffersize, "/\n", 2);
+
+	else if (buffer_mod == READ && lexeme_buffer[0] == '\0' && (char_class[(uint8_t)buffer[i]] & CHAR_SPACE))
+		next = skip_class(buffer, i, buffersize, CHAR_SPACE);
+
+	// A word starting with a digit is an integer literal
+	else if (buffer_mod == READ && (char_class[(uint8_t)buffer[i]] & CHAR_WORD) && 
+		(lexeme_buffer[0] != '\0' || !(char_class[(uint8_t)buffer[i]] & CHAR_DIGIT)))
 	{
-		line_counter++;
-		column_counter = 1;
+		next = skip_class(buffer, i, buffersize, CHAR_WORD);
+
+		if (lexeme_buffer_counter + (next - i) + 2 > lexeme_buffer_size)
+		{
+			while (lexeme_buffer_counter + (next - i) + 2 > lexeme_buffer_size)
+				lexeme_buffer_size *= 2;
+
+			lexeme_buffer = realloc(lexeme_buffer, lexeme_buffer_size);
+		}
+		memcpy(lexeme_buffer + lexeme_buffer_counter, buffer + i, next - i);
+		lexeme_buffer_counter += next - i;
+		lexeme_buffer[lexeme_buffer_counter] = '\0';
 	}
+
+	return next;
 }
 
 void read_string_literal(uint *i, const uint is_charliteral)
@@ -394,8 +625,6 @@ void read_string_literal(uint *i, const uint is_charliteral)
 
 	while (buffer_mod == READ_STRING_LITERAL)
 	{
-		update_position(*i);
-
 		if (buffer[*i] == delimiter)
 		{
 			_token_type ltmp_tt = STRING_LITERAL;
@@ -403,10 +632,9 @@ void read_string_literal(uint *i, const uint is_charliteral)
 			if (is_charliteral)
 				ltmp_tt = CHAR_LITERAL;
 
-			emit_token(ltmp_tt, LITERAL, lexeme_buffer, tokens_counter, 
-				line_counter, column_counter);
+			emit_token(ltmp_tt, LITERAL, lexeme_buffer, lexed_counter, *i);
 			clear_buffer(lexeme_buffer, &lexeme_buffer_counter);
-			tokens_counter++;
+			lexed_counter++;
 			buffer_mod = READ;
 		}
 
@@ -450,7 +678,7 @@ void read_string_literal(uint *i, const uint is_charliteral)
 					escape_tmp[0] = '\0';
 					break;
 				default:
-					lexer_error(line_counter, column_counter, INVALID_ESCAPE);
+					lexer_error(*i + 1, INVALID_ESCAPE);
 			}
 
 			escape_tmp[1] = '\0';
@@ -497,19 +725,15 @@ void read_integer_literal(uint *i)
 		*/
 
 		for (;isxdigit(buffer[*i]) || (buffer[*i] == 'x' && lexeme_buffer[1] == '\0'); (*i)++)
-		{
-			update_position(*i);
 			read_buffer(buffer, *i, READ_INTEGER_LITERAL);
-		}
 		
 		if (isalpha(buffer[*i]) && !isxdigit(buffer[*i]))
-			lexer_error(line_counter, column_counter, IS_NOT_HEX);
+			lexer_error(*i, IS_NOT_HEX);
 
-		char* value = convert_decimal(lexeme_buffer);
+		_token* token = emit_token(INTEGER_LITERAL, LITERAL, lexeme_buffer, lexed_counter, *i - 1);
+		token->id = literal_read(token);
 		clear_buffer(lexeme_buffer, &lexeme_buffer_counter);
-		emit_token(INTEGER_LITERAL, LITERAL, value, tokens_counter, line_counter, column_counter);
-		free(value);
-		tokens_counter++;
+		lexed_counter++;
 		return;
 	}
 
@@ -518,19 +742,15 @@ void read_integer_literal(uint *i)
 	if (strcmp(prefix, "0b") == 0)
 	{
 		for (;_isbinary(buffer[*i]) || (buffer[*i] == 'b' && lexeme_buffer[1] == '\0'); (*i)++)
-		{
-			update_position(*i);
 			read_buffer(buffer, *i, READ_INTEGER_LITERAL);
-		}
 
 		if (isalpha(buffer[*i]) || (!_isbinary(buffer[*i]) && isdigit(buffer[*i])))
-			lexer_error(line_counter, column_counter, IS_NOT_BIN);
+			lexer_error(*i, IS_NOT_BIN);
 
-		char* value = convert_decimal(lexeme_buffer);
+		_token* token = emit_token(INTEGER_LITERAL, LITERAL, lexeme_buffer, lexed_counter, *i - 1);
+		token->id = literal_read(token);
 		clear_buffer(lexeme_buffer, &lexeme_buffer_counter);
-		emit_token(INTEGER_LITERAL, LITERAL, value, tokens_counter, line_counter, column_counter);
-		free(value);
-		tokens_counter++;
+		lexed_counter++;
 		return;
 	}
 
@@ -544,29 +764,25 @@ void read_integer_literal(uint *i)
 			dot_counter = 0;
 
 		if (dot_counter > 1)
-			lexer_error(line_counter, column_counter, MULTIPLE_DOTS);
+			lexer_error(*i, MULTIPLE_DOTS);
 
-		update_position(*i);
 		read_buffer(buffer, *i, READ_INTEGER_LITERAL); 
 	}
 
 	if (isalpha(buffer[*i]) || strcmp(lexeme_buffer, ".") == 0)
-		lexer_error(line_counter, column_counter, IS_NOT_DECIMAL);
+		lexer_error(*i, IS_NOT_DECIMAL);
 
-	emit_token(INTEGER_LITERAL, LITERAL, lexeme_buffer, tokens_counter, 
-		line_counter, column_counter);
+	_token* token = emit_token(INTEGER_LITERAL, LITERAL, lexeme_buffer, lexed_counter, *i - 1);
+	token->id = literal_read(token);
 	return;
 }
 
-void lexer_main(char* sourcefile_buffer, uint sf_counter, char* sourcefile_path)
+// The buffer_mod machine, kept behind --Legacy-lexer to check lexer_dfa against
+void lexer_legacy()
 {
-	buffer = strdup(sourcefile_buffer);
-	buffersize = sf_counter;
-	lexeme_buffer = malloc(lexeme_buffer_size);
-	lexeme_buffer[0] = '\0';
-	diagnostic_srcfile = sourcefile_path;
+	uint i = lexer_offset;
 
-	for (uint i = 0; i < buffersize; i++)
+	for (; i < buffersize && lexed_read == lexed_counter; i++)
 	{
 		if (lexeme_buffer_counter + 1 >= lexeme_buffer_size)
 		{
@@ -574,6 +790,9 @@ void lexer_main(char* sourcefile_buffer, uint sf_counter, char* sourcefile_path)
 			lexeme_buffer = realloc(lexeme_buffer, lexeme_buffer_size);
 		}
 
+		if ((i = skip_fast(i)) >= buffersize)
+			break;
+
 		/*
 			/~
 				Block comment
@@ -581,10 +800,7 @@ void lexer_main(char* sourcefile_buffer, uint sf_counter, char* sourcefile_path)
 		*/
 
 		if (buffer[i] == '@')
-		{
-			update_position(i);
 			continue;
-		}
 		
 		if (buffer[i] == '/' && buffer[i + 1] == '~')
 			buffer_mod = BLOCK_PASS;
@@ -592,10 +808,7 @@ void lexer_main(char* sourcefile_buffer, uint sf_counter, char* sourcefile_path)
 			buffer_mod = READ;
 
 		if (buffer_mod == BLOCK_PASS)
-		{
-			update_position(i);
 			continue;
-		}
 
 		// ~ <- Comment line
 
@@ -603,10 +816,7 @@ void lexer_main(char* sourcefile_buffer, uint sf_counter, char* sourcefile_path)
 			buffer_mod = PASS;
 
 		if (buffer_mod == PASS && buffer[i] != '\n')
-		{
-			update_position(i);
 			continue;
-		} 
 
 		if (buffer_mod == READ && (lexeme_buffer[0] == '\0' && 
 			(isdigit(buffer[i]) || buffer[i] == '.')))
@@ -656,8 +866,1000 @@ void lexer_main(char* sourcefile_buffer, uint sf_counter, char* sourcefile_path)
 		scan_word(&dt, i);
 		scan_operator(&lo, &ro, &i);
 		scan_symbol(&lo, &ro, i);
+	}
+
+	lexer_offset = i;
+	lexer_done = i >= buffersize;
+}
+
+/* ======================================== TABLE MACHINE ======================================== */
+
+/*
+	The transition table is generated from the token grammar
+	by scripts/lexgen.c. A step takes the class of the current
+	char and of the next one, so "/~", "0x" and the two char
+	operators are decided without going back.
+*/
+
+/*
+	A lexeme is the slice of the source at lexeme_from while
+	its chars follow each other there. An escape, or a word
+	that goes on after a comment, copies it into lexeme_buffer
+	and it is built there from then on.
+*/
+
+void lexeme_copy()
+{
+	if (lexeme_copied)
+		return;
+
+	if (lexeme_buffer_counter + 2 > lexeme_buffer_size)
+	{
+		while (lexeme_buffer_counter + 2 > lexeme_buffer_size)
+			lexeme_buffer_size *= 2;
+
+		lexeme_buffer = realloc(lexeme_buffer, lexeme_buffer_size);
+	}
+
+	memcpy(lexeme_buffer, buffer + lexeme_from, lexeme_buffer_counter);
+	lexeme_buffer[lexeme_buffer_counter] = '\0';
+	lexeme_copied = 1;
+}
+
+// Takes the source chars in [from, to)
+void lexeme_take(const uint from, const uint to)
+{
+	if (lexeme_buffer_counter == 0 && !lexeme_copied)
+		lexeme_from = from;
+
+	if (!lexeme_copied && lexeme_from + lexeme_buffer_counter == from)
+	{
+		lexeme_buffer_counter += to - from;
+		return;
+	}
+
+	lexeme_copy();
+
+	if (lexeme_buffer_counter + (to - from) + 2 > lexeme_buffer_size)
+	{
+		while (lexeme_buffer_counter + (to - from) + 2 > lexeme_buffer_size)
+			lexeme_buffer_size *= 2;
+
+		lexeme_buffer = realloc(lexeme_buffer, lexeme_buffer_size);
+	}
+
+	memcpy(lexeme_buffer + lexeme_buffer_counter, buffer + from, to - from);
+	lexeme_buffer_counter += to - from;
+	lexeme_buffer[lexeme_buffer_counter] = '\0';
+}
+
+// Takes a char that is not in the source
+void lexeme_append(const char c)
+{
+	lexeme_copy();
+	lexemebuffer_rcontrol();
+	lexeme_buffer[lexeme_buffer_counter] = c;
+	lexeme_buffer[lexeme_buffer_counter + 1] = '\0';
+	lexeme_buffer_counter++;
+}
+
+char* lexeme_text()
+{
+	return lexeme_copied ? lexeme_buffer : buffer + lexeme_from;
+}
+
+void lexeme_clear()
+{
+	lexeme_buffer_counter = 0;
+	lexeme_copied = 0;
+}
+
+// The word ends before the char at i
+void dfa_word(const uint i)
+{
+	if (lexeme_buffer_counter == 0)
+		return;
+
+	_token_group group;
+	_token_type type = query_word(lexeme_text(), lexeme_buffer_counter, &group);
+	_token* token = emit_slice(type, group, lexeme_text(), lexeme_buffer_counter,
+		lexed_counter++, i - 1);
+
+	if (type == INTEGER_LITERAL)
+		token->id = literal_read(token);
+
+	lexeme_clear();
+}
+
+uint dfa_run(const uint state, const uint i)
+{
+	// Chars that keep the state are taken a block at a time
+	uint next = i;
+
+	switch (dfa_runs[state])
+	{
+		case RUN_SPACE:
+			next = skip_class(buffer, i, lexer_stop, CHAR_SPACE);
+			break;
+		case RUN_WORD:
+			next = skip_class(buffer, i, lexer_stop, CHAR_WORD);
+			break;
+		case RUN_STRING:
+			next = find_any(buffer, i, lexer_stop, "\"\\", 2);
+			break;
+		case RUN_LINE:
+			next = find_any(buffer, i, lexer_stop, "/\n", 2);
+			break;
+		case RUN_BLOCK:
+			next = find_any(buffer, i, lexer_stop, "~", 1);
+			break;
+	}
+
+	if (next == i)
+		return i;
+
+	if (dfa_runs[state] == RUN_WORD || dfa_runs[state] == RUN_STRING)
+		lexeme_take(i, next);
+
+	return next;
+}
+
+void dfa_operator(const uint i, const uint length)
+{
+	_token_type type = length == 2 ? double_operators[(uint8_t)buffer[i]].token_type :
+		single_operators[(uint8_t)buffer[i]];
+
+	emit_slice(type, type <= LOPERATOR_NOT ? LOPERATOR : ROPERATOR, buffer + i, length,
+		lexed_counter++, i + length - 1);
+}
+
+const LEXER_LAYER_ERROR_TYPE dfa_errors[] =
+{
+	[DO_INVALID_CHAR] = INVALID_CHAR,
+	[DO_INVALID_ESCAPE] = INVALID_ESCAPE,
+	[DO_IS_NOT_HEX] = IS_NOT_HEX,
+	[DO_IS_NOT_BIN] = IS_NOT_BIN,
+	[DO_IS_NOT_DECIMAL] = IS_NOT_DECIMAL,
+	[DO_MULTIPLE_DOTS] = MULTIPLE_DOTS,
+};
+
+void lexer_fail(const LEXER_LAYER_ERROR_TYPE error, const uint i)
+{
+	if (lexer_self == NULL)
+		lexer_error(i, error);
+
+	// A worker may be lexing from a wrong guess, the error waits for the check
+	lexer_self->failed = 1;
+	lexer_self->error = error;
+	lexer_self->error_position = i;
+	lexer_done = 1;
+}
+
+void lexer_dfa()
+{
+	/*
+		Runs until it emits a token, the state is kept for the
+		next call. The char after a literal is read before it
+		stops, like the old machine did, so a bad char there is
+		still reported before the parser sees the literal.
+	*/
+
+	uint state = lexer_state;
+	uint i = lexer_offset;
+
+	while (lexed_read == lexed_counter || state == DFA_AFTER)
+	{
+		i = dfa_run(state, i);
+
+		// A literal still reads the '\0' after the buffer
+		if (i > buffersize || (i >= lexer_stop && !(i == buffersize && dfa_tails[state])))
+		{
+			lexer_done = 1;
+			break;
+		}
+
+		const uint8_t c = buffer[i];
+		const uint8_t n = i < buffersize ? buffer[i + 1] : '\0';
+		const _dfa_entry step = dfa_table[state][dfa_classes[c]][dfa_lookaheads[n]];
+		state = step.next;
 
-		update_position(i);
+		switch (step.action)
+		{
+			case DO_SKIP:
+				i++;
+				break;
+			case DO_APPEND:
+				lexeme_take(i, i + 1);
+				i++;
+				break;
+			case DO_ESCAPE:
+				lexeme_append(dfa_escapes[c]);
+				i++;
+				break;
+			case DO_STRING:
+				emit_slice(STRING_LITERAL, LITERAL, lexeme_text(), lexeme_buffer_counter,
+					lexed_counter++, i++);
+				lexeme_clear();
+				break;
+			case DO_SPACE:
+				dfa_word(i++);
+				break;
+			case DO_SYMBOL:
+				dfa_word(i);
+				emit_slice(symbol_table[c], SYMBOL, buffer + i, 1, lexed_counter++, i);
+				i++;
+				break;
+			case DO_OPERATOR:
+				dfa_word(i);
+				dfa_operator(i++, 1);
+				break;
+			case DO_OPERATOR_SPACE:
+			case DO_OPERATOR2:
+				dfa_word(i);
+				dfa_operator(i, step.action == DO_OPERATOR2 ? 2 : 1);
+				i += 2;
+				break;
+			case DO_RADIX:
+			{
+				_token* token = emit_slice(INTEGER_LITERAL, LITERAL, lexeme_text(), lexeme_buffer_counter,
+					lexed_counter++, i - 1);
+				token->id = literal_read(token);
+				lexeme_clear();
+				break;
+			}
+			case DO_HOLD:
+				break;
+			default:
+				// Only a worker gets back from an error
+				lexer_fail(dfa_errors[step.action], i);
+				lexer_state = state;
+				lexer_offset = i;
+				return;
+		}
 	}
-	free(lexeme_buffer);
+
+	lexer_state = state;
+	lexer_offset = i;
+}
+
+void chunk_push(lexer_chunk* chunk, const _token* token, const uint position)
+{
+	if (chunk->counter == chunk->size)
+	{
+		chunk->size *= 2;
+		chunk->tokens = realloc(chunk->tokens, sizeof(_token) * chunk->size);
+		chunk->positions = realloc(chunk->positions, sizeof(uint) * chunk->size);
+
+		if (chunk->tokens == NULL || chunk->positions == NULL)
+		{
+			fprintf(stderr, "Lexer realloc error\n");
+			exit(1);
+		}
+	}
+
+	chunk->tokens[chunk->counter] = *token;
+	chunk->positions[chunk->counter] = position;
+	chunk->counter++;
+}
+
+/*
+	Token cache for --cache-dir. The tokens of an include span
+	depend only on its text and the char after it, so they are
+	stored under that key and mapped back by the next compile
+	instead of being lexed again. An entry is used in place:
+	the header, the literals, then tokens and positions with
+	source offsets from the span start, then the names, which
+	name tokens hold by index, and the pooled text. A span that
+	ends inside a lexeme is not stored.
+*/
+
+#define TOKEN_CACHE_MAGIC "SEALTK1"
+#define TOKEN_CACHE_MIN (1 << 12)
+
+typedef struct
+{
+	char magic[8];
+	uint64_t key;
+	uint length;
+	uint tokens;
+	uint literals;
+	uint names;
+	uint name_bytes;
+	uint lexemes;
+
+	// Where the lexer stopped, from the span start
+	uint state;
+	uint offset;
+}
+token_cache_header;
+
+bool token_cache_stored = 0;
+
+char* token_cache_entry(const lexer_chunk* chunk)
+{
+	uint length = strlen(arg_flagref.cache_dir) + 32;
+	char* entry = malloc(length);
+	snprintf(entry, length, "%s/%016llx.sealtk", arg_flagref.cache_dir, (unsigned long long)chunk->key);
+	return entry;
+}
+
+/*
+	Everything in an entry is used as an index or a length, so
+	it is checked before any of it is read. A bad entry is left
+	and the span is lexed.
+*/
+
+bool token_cache_check(const lexer_chunk* chunk, const token_cache_header* header, const char* at)
+{
+	const _token* tokens = (const _token*)(at + sizeof(_literal) * header->literals);
+	const uint* positions = (const uint*)(tokens + header->tokens);
+	const uint* name_offsets = positions + header->tokens;
+	const char* name_text = (const char*)(name_offsets + header->names);
+	const char* lexemes = name_text + header->name_bytes;
+
+	if (header->state >= DFA_STATES || header->offset < header->length ||
+		header->offset > buffersize - chunk->start || lexemes[header->lexemes - 1] != '\0')
+		return 0;
+
+	for (uint k = 0; k < header->tokens; k++)
+	{
+		const _token* token = &tokens[k];
+		uint8_t pooled = *(const uint8_t*)&token->pooled;
+		uint64_t end = (uint64_t)token->offset + token->length;
+
+		// The offset of an empty string is not read
+		if (token->token_type > NON || token->token_group > _IDENTIFIER || pooled > 1 ||
+			positions[k] >= buffersize - chunk->start ||
+			(token->length != 0 && end > (pooled ? header->lexemes - 1 : header->length)))
+			return 0;
+
+		if (token->token_type == INTEGER_LITERAL && token->id >= header->literals)
+			return 0;
+
+		if (token->token_group != _IDENTIFIER && token->token_group != DTYPE)
+			continue;
+
+		// A name is read with the length of the token, up to its '\0'
+		if (token->id >= header->names || (uint64_t)name_offsets[token->id] + token->length >= header->name_bytes ||
+			name_text[name_offsets[token->id] + token->length] != '\0')
+			return 0;
+	}
+
+	return 1;
+}
+
+bool token_cache_load(lexer_chunk* chunk)
+{
+	char* entry = token_cache_entry(chunk);
+	uint size = 0;
+	char* mapped = map_buffer(entry, &size);
+	const char* at = mapped;
+	token_cache_header header;
+
+	if (mapped == NULL)
+	{
+		free(entry);
+		return 0;
+	}
+
+	if (size < sizeof(header))
+	{
+		unmap_buffer(mapped, size);
+		free(entry);
+		return 0;
+	}
+
+	memcpy(&header, at, sizeof(header));
+
+	uint64_t total = sizeof(header) + (uint64_t)sizeof(_literal) * header.literals +
+		(uint64_t)(sizeof(_token) + sizeof(uint)) * header.tokens + (uint64_t)sizeof(uint) * header.names +
+		header.name_bytes + header.lexemes;
+
+	if (memcmp(header.magic, TOKEN_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.key != chunk->key ||
+		header.length != chunk->end - chunk->start || header.lexemes == 0 || total != size ||
+		!token_cache_check(chunk, &header, at + sizeof(header)))
+	{
+		unmap_buffer(mapped, size);
+		free(entry);
+		return 0;
+	}
+
+	at += sizeof(header);
+	chunk->literals = (_literal*)at;
+	chunk->literals_counter = header.literals;
+	at += sizeof(_literal) * header.literals;
+	chunk->tokens = (_token*)at;
+	chunk->counter = header.tokens;
+	at += sizeof(_token) * header.tokens;
+	chunk->positions = (uint*)at;
+	at += sizeof(uint) * header.tokens;
+	chunk->name_offsets = (const uint*)at;
+	at += sizeof(uint) * header.names;
+	chunk->name_text = at;
+	at += header.name_bytes;
+	chunk->lexemes = (char*)at;
+	chunk->lexemes_counter = header.lexemes;
+
+	chunk->names = malloc(sizeof(uint) * (header.names + 1));
+	memset(chunk->names, 0xff, sizeof(uint) * (header.names + 1));
+
+	chunk->state = header.state;
+	chunk->offset = chunk->start + header.offset;
+	chunk->lexeme_buffer_size = 32;
+	chunk->lexeme_buffer = malloc(chunk->lexeme_buffer_size);
+	chunk->lexeme_buffer[0] = '\0';
+	chunk->base = chunk->start;
+	chunk->cached = 1;
+	chunk->mapped = mapped;
+	chunk->mapped_size = size;
+
+	// Recently used
+	utimensat(AT_FDCWD, entry, NULL, 0);
+	free(entry);
+	return 1;
+}
+
+/*
+	A span missing from the cache is lexed by the main thread
+	like any other text, and its tokens are written out as the
+	parser takes them. Tokens and positions go to temporary
+	files; only the literals, names and pooled text of the span
+	are kept until the entry is stored.
+*/
+
+typedef struct
+{
+	lexer_chunk* chunk;
+	FILE* tokens;
+	FILE* positions;
+	uint counter;
+
+	_literal* literals;
+	uint literals_counter;
+	uint literals_size;
+
+	// Names are numbered by their first use
+	uint* slots;
+	uint slots_size;
+	uint* name_offsets;
+	uint* name_lengths;
+	uint names;
+	uint names_size;
+	char* name_text;
+	uint name_bytes;
+	uint name_size;
+
+	char* lexemes;
+	uint lexemes_counter;
+	uint lexemes_size;
+}
+token_cache_writer;
+
+token_cache_writer writer;
+bool token_cache_writing = 0;
+
+void token_cache_begin(lexer_chunk* chunk)
+{
+	memset(&writer, 0, sizeof(writer));
+	writer.chunk = chunk;
+	writer.tokens = tmpfile();
+	writer.positions = tmpfile();
+
+	// Best effort like the translation unit cache
+	if (writer.tokens == NULL || writer.positions == NULL)
+	{
+		if (writer.tokens != NULL)
+			fclose(writer.tokens);
+		if (writer.positions != NULL)
+			fclose(writer.positions);
+
+		return;
+	}
+
+	writer.slots_size = 64;
+	writer.slots = malloc(sizeof(uint) * writer.slots_size);
+	memset(writer.slots, 0xff, sizeof(uint) * writer.slots_size);
+
+	// Pooled text starts with the empty string, like a lexeme pool
+	writer.lexemes_size = 64;
+	writer.lexemes = malloc(writer.lexemes_size);
+	writer.lexemes[0] = '\0';
+	writer.lexemes_counter = 1;
+
+	token_cache_writing = 1;
+}
+
+uint token_cache_name(const char* text, const uint length)
+{
+	if (writer.names * 2 >= writer.slots_size)
+	{
+		writer.slots_size *= 2;
+		writer.slots = realloc(writer.slots, sizeof(uint) * writer.slots_size);
+		memset(writer.slots, 0xff, sizeof(uint) * writer.slots_size);
+
+		for (uint k = 0; k < writer.names; k++)
+		{
+			uint slot = fnv_hash(writer.name_text + writer.name_offsets[k], writer.name_lengths[k]) &
+				(writer.slots_size - 1);
+
+			while (writer.slots[slot] != UINT_MAX)
+				slot = (slot + 1) & (writer.slots_size - 1);
+
+			writer.slots[slot] = k;
+		}
+	}
+
+	uint slot = fnv_hash(text, length) & (writer.slots_size - 1);
+
+	for (; writer.slots[slot] != UINT_MAX; slot = (slot + 1) & (writer.slots_size - 1))
+	{
+		const uint k = writer.slots[slot];
+
+		if (writer.name_lengths[k] == length && memcmp(writer.name_text + writer.name_offsets[k], text, length) == 0)
+			return k;
+	}
+
+	if (writer.names == writer.names_size)
+	{
+		writer.names_size = writer.names_size * 2 + 64;
+		writer.name_offsets = realloc(writer.name_offsets, sizeof(uint) * writer.names_size);
+		writer.name_lengths = realloc(writer.name_lengths, sizeof(uint) * writer.names_size);
+	}
+
+	while (writer.name_bytes + length + 1 > writer.name_size)
+		writer.name_size = writer.name_size * 2 + 64;
+
+	writer.name_text = realloc(writer.name_text, writer.name_size);
+	memcpy(writer.name_text + writer.name_bytes, text, length);
+	writer.name_text[writer.name_bytes + length] = '\0';
+
+	writer.name_offsets[writer.names] = writer.name_bytes;
+	writer.name_lengths[writer.names] = length;
+	writer.name_bytes += length + 1;
+	writer.slots[slot] = writer.names;
+	return writer.names++;
+}
+
+// Tokens from lexed, up to lexed_counter, in the form the entry keeps them
+void token_cache_record(uint from)
+{
+	const uint start = writer.chunk->start;
+
+	for (; from < lexed_counter; from++)
+	{
+		_token token = lexed[from & (LEXED_RING - 1)];
+		uint position = lexed_positions[from & (LEXED_RING - 1)] - start;
+		const char* text = token_text(&token);
+
+		if (token.pooled)
+		{
+			while (writer.lexemes_counter + token.length + 1 > writer.lexemes_size)
+				writer.lexemes_size *= 2;
+
+			writer.lexemes = realloc(writer.lexemes, writer.lexemes_size);
+			memcpy(writer.lexemes + writer.lexemes_counter, text, token.length);
+			writer.lexemes[writer.lexemes_counter + token.length] = '\0';
+			token.offset = writer.lexemes_counter;
+			writer.lexemes_counter += token.length + 1;
+		}
+		else
+			token.offset -= start;
+
+		if (token.token_type == INTEGER_LITERAL)
+		{
+			if (writer.literals_counter == writer.literals_size)
+			{
+				writer.literals_size = writer.literals_size * 2 + 64;
+				writer.literals = realloc(writer.literals, sizeof(_literal) * writer.literals_size);
+			}
+
+			writer.literals[writer.literals_counter] = literals[token.id];
+			token.id = writer.literals_counter++;
+		}
+
+		if (token.token_group == _IDENTIFIER || token.token_group == DTYPE)
+			token.id = token_cache_name(text, token.length);
+
+		fwrite(&token, sizeof(token), 1, writer.tokens);
+		fwrite(&position, sizeof(position), 1, writer.positions);
+		writer.counter++;
+	}
+}
+
+void token_cache_copy(FILE* from, FILE* out)
+{
+	char block[1 << 14];
+	size_t count = 0;
+
+	rewind(from);
+
+	while ((count = fread(block, 1, sizeof(block), from)) > 0)
+		fwrite(block, 1, count, out);
+}
+
+// The lexer is at the end of the span, a span that ends inside a lexeme is not stored
+void token_cache_finish()
+{
+	const lexer_chunk* chunk = writer.chunk;
+	token_cache_writing = 0;
+
+	if (lexeme_buffer_counter == 0 && !ferror(writer.tokens) && !ferror(writer.positions))
+	{
+		token_cache_header header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, TOKEN_CACHE_MAGIC, sizeof(header.magic));
+		header.key = chunk->key;
+		header.length = chunk->end - chunk->start;
+		header.tokens = writer.counter;
+		header.literals = writer.literals_counter;
+		header.names = writer.names;
+		header.name_bytes = writer.name_bytes;
+		header.lexemes = writer.lexemes_counter;
+		header.state = lexer_state;
+		header.offset = lexer_offset - chunk->start;
+
+		char* entry = token_cache_entry(chunk);
+		uint length = strlen(entry) + 32;
+		char* temp = malloc(length);
+		snprintf(temp, length, "%s.%d", entry, (int)getpid());
+
+		FILE* out = fopen(temp, "wb");
+
+		if (out != NULL)
+		{
+			fwrite(&header, sizeof(header), 1, out);
+			fwrite(writer.literals, sizeof(_literal), writer.literals_counter, out);
+			token_cache_copy(writer.tokens, out);
+			token_cache_copy(writer.positions, out);
+			fwrite(writer.name_offsets, sizeof(uint), writer.names, out);
+			fwrite(writer.name_text, 1, writer.name_bytes, out);
+			fwrite(writer.lexemes, 1, writer.lexemes_counter, out);
+
+			if (fclose(out) != 0 || rename(temp, entry) != 0)
+				unlink(temp);
+			else
+				token_cache_stored = 1;
+		}
+
+		free(entry);
+		free(temp);
+	}
+
+	fclose(writer.tokens);
+	fclose(writer.positions);
+	free(writer.literals);
+	free(writer.slots);
+	free(writer.name_offsets);
+	free(writer.name_lengths);
+	free(writer.name_text);
+	free(writer.lexemes);
+}
+
+// Each name of an entry is interned once, in stream order
+uint chunk_name(lexer_chunk* chunk, const _token* token)
+{
+	if (chunk->names[token->id] == UINT_MAX)
+		chunk->names[token->id] = intern_id(chunk->name_text + chunk->name_offsets[token->id], token->length);
+
+	return chunk->names[token->id];
+}
+
+void* lexer_worker(void* arg)
+{
+	lexer_chunk* chunk = arg;
+
+	// Everything the machine keeps is thread local, it starts fresh here
+	lexer_self = chunk;
+	lexer_offset = chunk->start;
+	lexer_stop = chunk->end;
+	lexer_state = DFA_READ;
+	lexeme_pool_init(chunk->end - chunk->start);
+	lexeme_buffer = malloc(lexeme_buffer_size);
+	lexeme_buffer[0] = '\0';
+
+	chunk->size = (chunk->end - chunk->start) / 4 + 16;
+	chunk->tokens = malloc(sizeof(_token) * chunk->size);
+	chunk->positions = malloc(sizeof(uint) * chunk->size);
+
+	while (!lexer_done)
+	{
+		lexer_dfa();
+
+		// Serially the error comes before the tokens of the same run
+		if (chunk->failed)
+			break;
+
+		for (; lexed_read < lexed_counter; lexed_read++)
+			chunk_push(chunk, &lexed[lexed_read & (LEXED_RING - 1)],
+				lexed_positions[lexed_read & (LEXED_RING - 1)]);
+	}
+
+	chunk->lexemes = lexemes;
+	chunk->lexemes_counter = lexemes_counter;
+	chunk->literals = literals;
+	chunk->literals_counter = literals_counter;
+	chunk->state = lexer_state;
+	chunk->offset = lexer_offset;
+	chunk->lexeme_buffer = lexeme_buffer;
+	chunk->lexeme_buffer_size = lexeme_buffer_size;
+	chunk->lexeme_buffer_counter = lexeme_buffer_counter;
+	chunk->lexeme_from = lexeme_from;
+	chunk->lexeme_copied = lexeme_copied;
+	return NULL;
+}
+
+void chunk_free(lexer_chunk* chunk)
+{
+	// A cached chunk's arrays are in its entry
+	if (!chunk->cached)
+	{
+		free(chunk->tokens);
+		free(chunk->positions);
+		free(chunk->lexemes);
+		free(chunk->literals);
+	}
+	else
+		unmap_buffer(chunk->mapped, chunk->mapped_size);
+
+	free(chunk->names);
+	free(chunk->lexeme_buffer);
+}
+
+int chunk_compare(const void* a, const void* b)
+{
+	const lexer_chunk* left = a;
+	const lexer_chunk* right = b;
+
+	return (left->start > right->start) - (left->start < right->start);
+}
+
+void lexer_split()
+{
+	if (arg_flagref.legacy_lexer)
+		return;
+
+	// The main thread lexes the first chunk as the parser reads it
+	uint count = buffersize / LEXER_CHUNK_MIN;
+
+	if (arg_flagref.jobs < 2 || count < 2)
+		count = 1;
+	else if (count > arg_flagref.jobs)
+		count = arg_flagref.jobs;
+
+	chunks = calloc(include_spans_counter + count, sizeof(lexer_chunk));
+
+	for (uint k = 0; k < include_spans_counter && arg_flagref.cache_dir != NULL; k++)
+	{
+		if (include_spans[k].length < TOKEN_CACHE_MIN)
+			continue;
+
+		lexer_chunk* chunk = &chunks[chunks_counter++];
+		chunk->start = include_spans[k].offset;
+		chunk->end = chunk->start + include_spans[k].length;
+		chunk->span = 1;
+
+		// Its tokens also depend on the char after it, and on whether there is one
+		chunk->key = include_spans[k].key * 31 + (chunk->end < buffersize ? (uint8_t)buffer[chunk->end] : 256);
+	}
+
+	// A cut inside a span is left out
+	uint spans = chunks_counter;
+	uint span = 0;
+
+	for (uint k = 1; k < count; k++)
+	{
+		uint from = (uint)((uint64_t)buffersize * k / count);
+		const char* newline = memchr(buffer + from, '\n', buffersize - from);
+
+		if (newline == NULL)
+			break;
+
+		uint start = newline - buffer + 1;
+
+		while (span < spans && chunks[span].end <= start)
+			span++;
+
+		if (start >= buffersize || (span < spans && chunks[span].start <= start) ||
+			(chunks_counter > spans && start <= chunks[chunks_counter - 1].start))
+			continue;
+
+		chunks[chunks_counter++].start = start;
+	}
+
+	if (chunks_counter == 0)
+		return;
+
+	// A cut runs up to the next chunk
+	qsort(chunks, chunks_counter, sizeof(lexer_chunk), chunk_compare);
+
+	for (uint k = 0; k < chunks_counter; k++)
+	{
+		if (!chunks[k].span)
+			chunks[k].end = k + 1 < chunks_counter ? chunks[k + 1].start : buffersize;
+	}
+
+	lexer_stop = chunks[0].start;
+
+	/*
+		A chunk without a thread is lexed serially. A span that
+		is not in the cache is lexed by the main thread when the
+		lexer gets to it, and stored as its tokens are read.
+	*/
+
+	for (uint k = 0; k < chunks_counter; k++)
+	{
+		if (!chunks[k].span)
+			chunks[k].started = pthread_create(&chunks[k].thread, NULL, lexer_worker, &chunks[k]) == 0;
+		else
+			token_cache_load(&chunks[k]);
+	}
+}
+
+// Serial lexing stops where the next chunk starts
+uint chunk_stop()
+{
+	return chunks_next < chunks_counter ? chunks[chunks_next].start : buffersize;
+}
+
+bool chunk_advance()
+{
+	// The lexer is at lexer_stop, the end of a span being stored or where the next chunk starts
+	if (token_cache_writing)
+	{
+		token_cache_finish();
+		lexer_stop = chunk_stop();
+		lexer_done = 0;
+		return 1;
+	}
+
+	if (chunks_next == chunks_counter)
+		return 0;
+
+	lexer_chunk* chunk = &chunks[chunks_next++];
+	bool guess = lexer_offset == chunk->start && lexer_state == DFA_READ && lexeme_buffer_counter == 0;
+
+	// Lexed alone, a span missing from the cache can be stored
+	if (chunk->span && !chunk->cached && guess)
+	{
+		token_cache_begin(chunk);
+		lexer_stop = chunk->end;
+		lexer_done = 0;
+		return 1;
+	}
+
+	if (chunk->started)
+		pthread_join(chunk->thread, NULL);
+
+	if ((chunk->started || chunk->cached) && guess)
+	{
+		chunk_reading = chunk;
+		chunk_read = 0;
+		chunk_pool = lexeme_push(chunk->lexemes, chunk->lexemes_counter - 1);
+		chunk_literal = literal_push(chunk->literals, chunk->literals_counter);
+
+		if (!chunk->cached)
+		{
+			free(chunk->lexemes);
+			free(chunk->literals);
+		}
+
+		chunk->lexemes = NULL;
+		chunk->literals = NULL;
+	}
+	else
+		chunk_free(chunk);
+
+	lexer_stop = chunk_stop();
+	lexer_done = 0;
+	return 1;
+}
+
+void chunk_forward()
+{
+	lexer_chunk* chunk = chunk_reading;
+
+	if (chunk_read == chunk->counter)
+	{
+		if (chunk->failed)
+			lexer_error(chunk->error_position, chunk->error);
+
+		// Go on from where the worker stopped
+		free(lexeme_buffer);
+		lexeme_buffer = chunk->lexeme_buffer;
+		lexeme_buffer_size = chunk->lexeme_buffer_size;
+		lexeme_buffer_counter = chunk->lexeme_buffer_counter;
+		lexeme_from = chunk->lexeme_from;
+		lexeme_copied = chunk->lexeme_copied;
+		chunk->lexeme_buffer = NULL;
+
+		lexer_state = chunk->state;
+		lexer_offset = chunk->offset;
+		lexer_stop = chunk_stop();
+		lexer_done = 0;
+
+		chunk_free(chunk);
+		chunk_reading = NULL;
+		return;
+	}
+
+	for (; chunk_read < chunk->counter && lexed_counter - lexed_read < LEXED_RING; chunk_read++)
+	{
+		_token* token = &lexed[lexed_counter & (LEXED_RING - 1)];
+
+		*token = chunk->tokens[chunk_read];
+		lexed_positions[lexed_counter & (LEXED_RING - 1)] = chunk->positions[chunk_read] + chunk->base;
+		token->offset += token->pooled ? chunk_pool : chunk->base;
+
+		if (token->token_type == INTEGER_LITERAL)
+			token->id += chunk_literal;
+
+		if (token->token_group == _IDENTIFIER || token->token_group == DTYPE)
+			token->id = chunk->cached ? chunk_name(chunk, token) : intern_id(token_text(token), token->length);
+
+		lexed_counter++;
+	}
+}
+
+bool lexer_next(_token* token, uint* position)
+{
+	while (lexed_read == lexed_counter)
+	{
+		if (chunk_reading != NULL)
+			chunk_forward();
+		else if (!lexer_done)
+		{
+			uint from = lexed_counter;
+
+			if (arg_flagref.legacy_lexer)
+				lexer_legacy();
+			else
+				lexer_dfa();
+
+			if (token_cache_writing)
+				token_cache_record(from);
+		}
+		else if (!chunk_advance())
+		{
+			free(lexeme_buffer);
+			lexeme_buffer = NULL;
+
+			if (token_cache_stored)
+				cache_evict();
+
+			return 0;
+		}
+	}
+
+	*token = lexed[lexed_read & (LEXED_RING - 1)];
+	*position = lexed_positions[lexed_read & (LEXED_RING - 1)];
+	lexed_read++;
+	return 1;
+}
+
+bool lexer_forward()
+{
+	_token token;
+	uint position;
+
+	if (!lexer_next(&token, &position))
+		return 0;
+
+	token_push(&token, position);
+	return 1;
+}
+
+void lexer_main(char* sourcefile_buffer, uint sf_counter, char* sourcefile_path)
+{
+	// Nothing is lexed yet, lexer_next runs the lexer as tokens are read
+	buffer = sourcefile_buffer;
+	buffersize = sf_counter;
+	lexeme_pool_init(buffersize);
+	intern_init();
+	lexeme_buffer = malloc(lexeme_buffer_size);
+	lexeme_buffer[0] = '\0';
+	diagnostic_srcfile = sourcefile_path;
+	lexer_state = DFA_READ;
+	lexer_stop = buffersize;
+	lexer_split();
+	token_source = lexer_forward;
 }
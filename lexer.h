@@ -2,6 +2,7 @@
 #define LEXER_H
 
 #include "common.h"
+#include "diagnostic.h"
 
 typedef enum
 {
@@ -97,61 +98,126 @@ _token_group;
 
 typedef struct
 {
-	const char lexeme;
-	_token_type token_type;
+	char second;        // '\0' if there is no two char operator
+	uint8_t token_type; // _token_type
 }
-_symbol;
+_operator;
 
 typedef struct
 {
 	const char *lexeme;
-	_token_type token_type;
+	uint8_t length;
+	uint8_t token_type;  // _token_type
+	uint8_t token_group; // DTYPE or KEYWORD
 }
-_loperator;
+_word;
+
+/* TOKEN STRUCT */
+
+/*
+	A token is 16 bytes. Its text is a slice of the source,
+	so it has no '\0' and is read with its length. Only text
+	that is not in the source as it is, like a string with
+	escapes, is written into the lexeme pool. Names (identifiers and data types) also carry
+	their interned id. Its position is kept apart, as the
+	offset of its last char in the source.
+*/
 
 typedef struct
 {
-	const char *lexeme;
-	_token_type token_type;
+	uint8_t token_type;  // _token_type
+	uint8_t token_group; // _token_group
+	bool pooled;         // text is in lexemes, not in the source
+
+	uint offset;
+	uint length;
+	uint id;     // in interned for names, in literals for numbers
 }
-_roperator;
+_token;
 
-typedef struct
+extern char* buffer; // source being lexed
+extern _Thread_local char* lexemes;
+extern _Thread_local _literal* literals;
+
+static inline char* token_text(const _token* token)
 {
-	const char *lexeme;
-	_token_type token_type;
+	return (token->pooled ? lexemes : buffer) + token->offset;
 }
-_data_type;
 
-typedef struct
+static inline bool token_is(const _token* token, const char* text)
 {
-	const char *lexeme;
-	_token_type token_type;
+	return strlen(text) == token->length && memcmp(token_text(token), text, token->length) == 0;
 }
-_keyword;
 
-/* TOKEN STRUCT */
+// Value of an INTEGER_LITERAL token
+static inline const _literal* token_literal(const _token* token)
+{
+	return &literals[token->id];
+}
 
-typedef struct
+// Interned text of any token, for text that is kept past the token
+static inline char* token_string(const _token* token)
+{
+	return interned[intern_id(token_text(token), token->length)];
+}
+
+// Interned name of an identifier or data type token
+static inline char* token_name(const _token* token)
 {
-	_token_type token_type;
-	_token_group token_group;
+	return interned[token->id];
+}
+
+/*
+	Tokens are lexed as the parser asks for them. The parser
+	reads them by their index in the stream, out of a ring of
+	the last TOKEN_RING tokens. It looks one token back and two
+	ahead at most, so token memory does not grow with the source.
+*/
+
+#define TOKEN_RING 64
+
+extern _token tokens[TOKEN_RING];
+extern uint token_positions[TOKEN_RING];
+extern uint tokens_counter; // pushed into the ring so far
+extern _token token_end;
+
+// Pushes one more token into the ring, 0 at the end of the stream
+extern bool (*token_source)();
+
+void token_push(const _token* token, const uint position);
+bool token_fill(uint i);
+bool lexer_next(_token* token, uint* position);
 
-			  // LEXEME_BUFFER_LEN
-	char value[256];
+// Pulls tokens up to i, 0 if the stream ends before it
+static inline bool token_has(uint i)
+{
+	return i < tokens_counter || token_fill(i);
+}
 
-	char* file;
-	uint line;
-	uint column;
+// Past the last token reads an empty NON token
+static inline _token* token_at(uint i)
+{
+	return token_has(i) ? &tokens[i & (TOKEN_RING - 1)] : &token_end;
 }
-_token;
 
-extern _token* tokens;
-extern uint tokens_counter;
+// Past the last token reads the position of the last one
+static inline uint token_pos(uint i)
+{
+	if (!token_has(i))
+	{
+		if (tokens_counter == 0)
+			return NO_POSITION;
+
+		i = tokens_counter - 1;
+	}
+
+	return token_positions[i & (TOKEN_RING - 1)];
+}
 
 extern char* diagnostic_srcfile;
 
 void lexer_main(char* sourcefile_buffer, uint sf_counter, char* sourcefile_path);
+const char* literal_text(const char* text, const _literal* literal, char* out, const uint size);
 void print_tokens(uint ex);
 
 #endif
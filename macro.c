@@ -0,0 +1,476 @@
+/*
+
+	Seal Compiler - Macro layer
+	Copyright (C) 2026 Habil Yıldırım
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "macro.h"
+#include "diagnostic.h"
+#include <limits.h>
+
+/*
+	DEFINE expansion on the token stream, between the lexer
+	and the parser.
+
+		DEFINE LIMIT 40 $
+		DEFINE SQUARE(x) x * x $
+
+	A '(' right after the name (no space) starts a parameter
+	list. Macros are usable after their definition; expanded
+	tokens take the position of the macro name they replace.
+	The DEFINE tokens are kept in the stream for the parser.
+*/
+
+macro* macros = NULL;
+uint macros_counter = 0;
+
+uint* macro_slots = NULL;
+uint macro_slots_size = 0;
+
+// Bumped by every DEFINE, older memos are stale
+uint macro_generation = 0;
+
+// Macros being rescanned, memos are only made and used outside of them
+uint macro_depth = 0;
+
+void list_push(token_list* list, const macro_token* token, const macro_token* site)
+{
+	if (list->counter == list->size)
+	{
+		list->size = list->size == 0 ? 64 : list->size * 2;
+		list->data = realloc(list->data, sizeof(macro_token) * list->size);
+	}
+
+	macro_token* dst = &list->data[list->counter++];
+	dst->token = token->token;
+	dst->position = site != NULL ? site->position : token->position;
+}
+
+uint macro_hash(uint name)
+{
+	return name * 2654435761u;
+}
+
+void macro_slots_grow()
+{
+	macro_slots_size = macro_slots_size == 0 ? 64 : macro_slots_size * 2;
+	free(macro_slots);
+	macro_slots = malloc(sizeof(uint) * macro_slots_size);
+	memset(macro_slots, 0xff, sizeof(uint) * macro_slots_size);
+
+	for (uint i = 0; i < macros_counter; i++)
+	{
+		uint slot = macro_hash(macros[i].name) & (macro_slots_size - 1);
+
+		while (macro_slots[slot] != UINT_MAX)
+			slot = (slot + 1) & (macro_slots_size - 1);
+
+		macro_slots[slot] = i;
+	}
+}
+
+uint macro_find(uint name)
+{
+	if (macros_counter == 0)
+		return UINT_MAX;
+
+	uint slot = macro_hash(name) & (macro_slots_size - 1);
+
+	for (;macro_slots[slot] != UINT_MAX; slot = (slot + 1) & (macro_slots_size - 1))
+	{
+		if (macros[macro_slots[slot]].name == name)
+			return macro_slots[slot];
+	}
+
+	return UINT_MAX;
+}
+
+uint macro_add(uint name)
+{
+	uint m = macro_find(name);
+
+	// Redefinition replaces the old body
+	if (m != UINT_MAX)
+	{
+		free(macros[m].params);
+		free(macros[m].body);
+		free(macros[m].memo.data);
+
+		memset(&macros[m], 0, sizeof(macro));
+		macros[m].name = name;
+		return m;
+	}
+
+	if ((macros_counter + 1) * 2 > macro_slots_size)
+		macro_slots_grow();
+
+	macros = realloc(macros, sizeof(macro) * (macros_counter + 1));
+	memset(&macros[macros_counter], 0, sizeof(macro));
+	macros[macros_counter].name = name;
+
+	uint slot = macro_hash(name) & (macro_slots_size - 1);
+
+	while (macro_slots[slot] != UINT_MAX)
+		slot = (slot + 1) & (macro_slots_size - 1);
+
+	macro_slots[slot] = macros_counter;
+	return macros_counter++;
+}
+
+bool macro_define(const macro_token* in, uint count, uint *i)
+{
+	/*
+		i points to DEFINE. On success it is left
+		on the closing '$' and the macro is added.
+		Malformed definitions are left to the parser.
+	*/
+
+	uint c = *i + 1;
+
+	if (c >= count || in[c].token.token_type != IDENTIFIER)
+		return 0;
+
+	const macro_token* name = &in[c++];
+	macro_token* params = NULL;
+	uint params_counter = 0;
+	bool function_like = 0;
+
+	// Identifier position is its last char, '(' must be the next one
+	if (c < count && in[c].token.token_type == SYMBOL_LPAREN && in[c].position == name->position + 1)
+	{
+		function_like = 1;
+		c++;
+
+		while (c < count && in[c].token.token_type != SYMBOL_RPAREN)
+		{
+			if (in[c].token.token_type != IDENTIFIER)
+				macro_error(in[c].position, MACRO_WRONG_PARAMS);
+
+			params = realloc(params, sizeof(macro_token) * (params_counter + 1));
+			params[params_counter++] = in[c++];
+
+			if (c < count && in[c].token.token_type == SYMBOL_COMMA)
+				c++;
+		}
+
+		if (c >= count)
+			macro_error(name->position, MACRO_WRONG_PARAMS);
+
+		c++;
+	}
+
+	uint start = c;
+
+	for (;c < count && in[c].token.token_type != SYMBOL_DOLAR; c++){}
+
+	if (c >= count)
+	{
+		free(params);
+		return 0;
+	}
+
+	uint index = macro_add(name->token.id);
+	macro* m = &macros[index];
+	m->params = params;
+	m->params_counter = params_counter;
+	m->function_like = function_like;
+	m->body_counter = c - start;
+	m->body = malloc(sizeof(macro_token) * (m->body_counter + 1));
+	memcpy(m->body, in + start, sizeof(macro_token) * m->body_counter);
+
+	macro_generation++;
+	(*i) = c;
+	return 1;
+}
+
+void expand_range(const macro_token* in, uint count, token_list* out, const macro_token* site);
+
+void expand_at(const macro_token* in, uint count, uint *i, token_list* out, const macro_token* site)
+{
+	const macro_token* token = &in[*i];
+	uint index = token->token.token_type == IDENTIFIER ? macro_find(token->token.id) : UINT_MAX;
+
+	if (index == UINT_MAX || macros[index].disabled)
+	{
+		list_push(out, token, site);
+		return;
+	}
+
+	const macro_token* at = site != NULL ? site : token;
+	macro* m = &macros[index];
+
+	if (!m->function_like)
+	{
+		if (macro_depth > 0)
+		{
+			m->disabled = 1;
+			macro_depth++;
+			expand_range(m->body, m->body_counter, out, at);
+			macro_depth--;
+			m->disabled = 0;
+			return;
+		}
+
+		if (!m->memoized || m->memo_generation != macro_generation)
+		{
+			m->memo.counter = 0;
+			m->disabled = 1;
+			macro_depth++;
+			expand_range(m->body, m->body_counter, &m->memo, at);
+			macro_depth--;
+			m->disabled = 0;
+			m->memo_generation = macro_generation;
+			m->memoized = 1;
+		}
+
+		for (uint c = 0; c < m->memo.counter; c++)
+			list_push(out, &m->memo.data[c], at);
+
+		return;
+	}
+
+	// Name of a function like macro without arguments
+	if (*i + 1 >= count || in[*i + 1].token.token_type != SYMBOL_LPAREN)
+	{
+		list_push(out, token, site);
+		return;
+	}
+
+	/*
+		Arguments are split on commas outside of parentheses
+		and expanded before they are put into the body
+	*/
+
+	token_list* args = malloc(sizeof(token_list) * (m->params_counter + 1));
+	memset(args, 0, sizeof(token_list) * (m->params_counter + 1));
+
+	uint argc = 0;
+	uint depth = 0;
+	uint start = *i + 2;
+	uint c = start;
+
+	for (;c < count; c++)
+	{
+		if (in[c].token.token_type == SYMBOL_LPAREN)
+			depth++;
+
+		if (in[c].token.token_type == SYMBOL_RPAREN && depth-- == 0)
+			break;
+
+		if (in[c].token.token_type == SYMBOL_COMMA && depth == 0)
+		{
+			if (argc >= m->params_counter)
+				macro_error(at->position, MACRO_ARGC_MISMATCH);
+
+			expand_range(in + start, c - start, &args[argc++], site);
+			start = c + 1;
+		}
+	}
+
+	if (c >= count)
+		macro_error(at->position, MACRO_MISSING_RPAREN);
+
+	// M() is zero arguments, not one empty argument
+	if (c > start || argc > 0)
+	{
+		if (argc >= m->params_counter)
+			macro_error(at->position, MACRO_ARGC_MISMATCH);
+
+		expand_range(in + start, c - start, &args[argc++], site);
+	}
+
+	if (argc != m->params_counter)
+		macro_error(at->position, MACRO_ARGC_MISMATCH);
+
+	token_list body = {0};
+
+	for (uint b = 0; b < m->body_counter; b++)
+	{
+		uint p = 0;
+
+		if (m->body[b].token.token_type == IDENTIFIER)
+		{
+			for (;p < m->params_counter && m->params[p].token.id != m->body[b].token.id; p++){}
+		}
+		else
+			p = m->params_counter;
+
+		if (p == m->params_counter)
+		{
+			list_push(&body, &m->body[b], at);
+			continue;
+		}
+
+		for (uint a = 0; a < args[p].counter; a++)
+			list_push(&body, &args[p].data[a], at);
+	}
+
+	m->disabled = 1;
+	macro_depth++;
+	expand_range(body.data, body.counter, out, at);
+	macro_depth--;
+	m->disabled = 0;
+
+	for (uint a = 0; a < argc; a++)
+		free(args[a].data);
+
+	free(args);
+	free(body.data);
+	(*i) = c;
+}
+
+void expand_range(const macro_token* in, uint count, token_list* out, const macro_token* site)
+{
+	for (uint i = 0; i < count; i++)
+		expand_at(in, count, &i, out, site);
+}
+
+/*
+	The expander sits between the lexer and the parser and hands
+	over one token at a time. Only a DEFINE or a macro call is
+	read ahead in full, up to its '$' or its closing ')'.
+*/
+
+// Lexed tokens that are not expanded yet
+token_list ahead = {0};
+uint ahead_first = 0;
+
+// Expanded tokens the parser has not taken yet
+token_list expanded = {0};
+uint expanded_first = 0;
+
+macro_token* ahead_at(uint k)
+{
+	// NULL past the end of the stream
+	while (ahead.counter <= ahead_first + k)
+	{
+		macro_token token;
+
+		if (!lexer_next(&token.token, &token.position))
+			return NULL;
+
+		list_push(&ahead, &token, NULL);
+	}
+
+	return &ahead.data[ahead_first + k];
+}
+
+void ahead_drop(uint count)
+{
+	ahead_first += count;
+
+	// Keeps the list from growing with the stream
+	if (ahead_first == ahead.counter || ahead_first >= 64)
+	{
+		ahead.counter -= ahead_first;
+		memmove(ahead.data, ahead.data + ahead_first, sizeof(macro_token) * ahead.counter);
+		ahead_first = 0;
+	}
+}
+
+bool expand_next()
+{
+	const macro_token* token = ahead_at(0);
+
+	if (token == NULL)
+		return 0;
+
+	if (token->token.token_type == KEYWORD_MACRO)
+	{
+		uint end = 1;
+
+		for (;ahead_at(end) != NULL && ahead_at(end)->token.token_type != SYMBOL_DOLAR; end++){}
+
+		uint c = 0;
+		const macro_token* window = &ahead.data[ahead_first];
+
+		// DEFINE tokens are kept as they are
+		if (!macro_define(window, ahead_at(end) != NULL ? end + 1 : end, &c))
+			c = 0;
+
+		for (uint w = 0; w <= c; w++)
+			list_push(&expanded, &window[w], NULL);
+
+		ahead_drop(c + 1);
+		return 1;
+	}
+
+	uint index = token->token.token_type == IDENTIFIER ? macro_find(token->token.id) : UINT_MAX;
+
+	if (index == UINT_MAX)
+	{
+		list_push(&expanded, token, NULL);
+		ahead_drop(1);
+		return 1;
+	}
+
+	uint end = 1;
+
+	// Arguments of a function like macro, up to the matching ')'
+	if (macros[index].function_like && ahead_at(1) != NULL && ahead_at(1)->token.token_type == SYMBOL_LPAREN)
+	{
+		uint depth = 0;
+
+		for (end = 2; ahead_at(end) != NULL; end++)
+		{
+			if (ahead_at(end)->token.token_type == SYMBOL_LPAREN)
+				depth++;
+
+			if (ahead_at(end)->token.token_type == SYMBOL_RPAREN && depth-- == 0)
+			{
+				end++;
+				break;
+			}
+		}
+	}
+
+	uint c = 0;
+	expand_at(&ahead.data[ahead_first], end, &c, &expanded, NULL);
+	ahead_drop(c + 1);
+	return 1;
+}
+
+bool macro_next()
+{
+	if (expanded_first == expanded.counter)
+	{
+		expanded_first = 0;
+		expanded.counter = 0;
+
+		// Without macros a token goes straight through
+		const macro_token* token = ahead_at(0);
+
+		if (token != NULL && macros_counter == 0 && token->token.token_type != KEYWORD_MACRO)
+		{
+			token_push(&token->token, token->position);
+			ahead_drop(1);
+			return 1;
+		}
+
+		if (!expand_next())
+			return 0;
+	}
+
+	const macro_token* token = &expanded.data[expanded_first++];
+	token_push(&token->token, token->position);
+	return 1;
+}
+
+void macro_main()
+{
+	token_source = macro_next;
+}
@@ -0,0 +1,46 @@
+#ifndef MACRO_H
+#define MACRO_H
+
+#include "lexer.h"
+
+typedef struct
+{
+	_token token;
+	uint position;
+}
+macro_token;
+
+typedef struct
+{
+	macro_token* data;
+	uint counter;
+	uint size;
+}
+token_list;
+
+typedef struct
+{
+	uint name; // interned id
+
+	// Parameter names, only for function like macros
+	macro_token* params;
+	uint params_counter;
+	bool function_like;
+
+	// Body is kept as tokens, it is never lexed again
+	macro_token* body;
+	uint body_counter;
+
+	// Expansion of parameterless macros, valid for memo_generation
+	token_list memo;
+	uint memo_generation;
+	bool memoized;
+
+	// Set while the macro's own expansion is rescanned
+	bool disabled;
+}
+macro;
+
+void macro_main();
+
+#endif
@@ -21,6 +21,7 @@
 #include "common.h"
 #include "preprocessor/preprocessor.h"
 #include "lexer.h"
+#include "macro.h"
 #include "parser.h"
 #include "semantic.h"
 #include "ir.h"
@@ -34,13 +35,52 @@ arg_flags arg_flagref;
 
 void parse_arg(uint argc, char** argv, char* *source, char* *output_name)
 {
-	for (uint i = 0; i < argc - 1; i++)
+	for (uint i = 0; i < argc; i++)
 	{
+		if (strcmp(argv[i], "--Time") == 0 || strcmp(argv[i], "-t") == 0)
+		{
+			arg_flagref.time = 1;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--Legacy-lexer") == 0)
+		{
+			arg_flagref.legacy_lexer = 1;
+			continue;
+		}
+
+		// Options below take a value
+		if (i + 1 >= argc)
+			break;
+
 		if (strcmp(argv[i], "--Compile") == 0 || strcmp(argv[i], "-c") == 0)
 			(*source) = argv[i + 1];
 		if (strcmp(argv[i], "--Output") == 0 || strcmp(argv[i], "-o") == 0)
 			(*output_name) = argv[i + 1];
 
+		if (strcmp(argv[i], "--Include") == 0 || strcmp(argv[i], "-I") == 0)
+		{
+			arg_flagref.include_paths = realloc(arg_flagref.include_paths,
+				sizeof(char*) * (arg_flagref.include_paths_counter + 1));
+			arg_flagref.include_paths[arg_flagref.include_paths_counter++] = argv[i + 1];
+			continue;
+		}
+
+		if (strcmp(argv[i], "--cache-dir") == 0)
+		{
+			arg_flagref.cache_dir = argv[i + 1];
+			continue;
+		}
+
+		if (strcmp(argv[i], "--Jobs") == 0 || strcmp(argv[i], "-j") == 0)
+		{
+			if (!is_integer(argv[i + 1]) || atoi(argv[i + 1]) < 1)
+				cli_error("Wrong jobs argument");
+
+			arg_flagref.jobs = atoi(argv[i + 1]);
+			continue;
+		}
+
 		if (strcmp(argv[i], "--Save") == 0 || strcmp(argv[i], "-s") == 0) 
 		{
 			if (strcmp(argv[i + 1], "asm") == 0)
@@ -67,6 +107,12 @@ void parse_arg(uint argc, char** argv, char* *source, char* *output_name)
 				continue;	
 			}
 
+			if (strcmp(argv[i + 1], "deps") == 0)
+			{
+				arg_flagref.deps = 1;
+				continue;
+			}
+
 			if (strcmp(argv[i + 1], "all") == 0)
 			{
 				arg_flagref.ir = 1;
@@ -90,17 +136,48 @@ int main(int argc, char *argv[])
 	arg_flagref.obj = 0;
 	arg_flagref.llvm = 0;
 	arg_flagref.ir = 0;
+	arg_flagref.time = 0;
+	arg_flagref.deps = 0;
+	arg_flagref.legacy_lexer = 0;
+	arg_flagref.jobs = 4;
+	arg_flagref.cache_dir = NULL;
+	arg_flagref.include_paths = NULL;
+	arg_flagref.include_paths_counter = 0;
 
 	char* output_name = NULL;
 	char* sourcefile_path = NULL;
 
 	parse_arg(argc, argv, &sourcefile_path, &output_name);
+
+	phase_start();
 	pp_main(&sourcefile_path);
+	phase_stop("preprocessor");
+
+	if (arg_flagref.deps)
+		pp_depfile(sourcefile_path, output_name);
+
+	// Tokens are lexed and expanded as the parser reads them
+	phase_start();
 	lexer_main(root_file, rf_counter, sourcefile_path); 
+	macro_main();
 	parser_main();
+	phase_stop("lexer+parser");
+
+	phase_start();
 	semantic_main();
+	phase_stop("semantic");
+
+	phase_start();
 	ir_main(sourcefile_path);
+	parser_free();
+	phase_stop("ir");
+
+	phase_start();
 	codegen_main(output_name);
+	phase_stop("codegen");
+
+	if (arg_flagref.time)
+		print_timings();
 
 	return 0;
 }
@@ -1,11 +1,20 @@
 #!/bin/lua
 
 cc = "gcc";
-flags = "-g -O0";
-sources = "main.c common.c preprocessor/preprocessor.c diagnostic.c lexer.c parser.c semantic.c ir.c codegen.c";
+flags = "-g -O0 -pthread";
+sources = "main.c common.c preprocessor/preprocessor.c diagnostic.c lexer.c macro.c parser.c semantic.c ir.c codegen.c";
 target = "bin/seal";
 
+-- The lexer's transition table is generated from the token grammar
+generator = "scripts/lexgen.c";
+generated = "lexer_dfa.h";
+
 function make()
+    if not os.execute(cc .. " " .. generator .. " -o bin/lexgen && bin/lexgen " .. generated) then
+        print("Lexer table cannot be generated.\n");
+        os.exit(1);
+    end
+
     local success, exit_type, code = os.execute(cc .. " " .. flags .. " " .. sources .. " -o " .. target);
     print("OUTPUT: " .. target .. "\n");
     print("SUCCESS: " .. tostring(success));
@@ -28,220 +28,262 @@
 
 void overflow_control(const uint c, PARSER_LAYER_ERROR_TYPE err)
 {
-	if (c >= tokens_counter)
-		parser_error(tokens[c - 1].line, tokens[c - 1].column, err);
+	if (!token_has(c))
+		parser_error(token_pos(c - 1), err);
 }
 
-int get_precedence(_token t)
+int get_precedence(const _token* t)
 {	
-    if (t.token_group != BINARY_OP)
+    if (t->token_group != BINARY_OP)
         return -1;
 
-    if ((strcmp(t.value, "*") == 0 || strcmp(t.value, "/") == 0) 
-    	|| (strcmp(t.value, "%") == 0))
+    if ((token_is(t, "*") || token_is(t, "/")) 
+    	|| (token_is(t, "%")))
         return 3;
 
-    if (strcmp(t.value, "+") == 0 || strcmp(t.value, "-") == 0)
+    if (token_is(t, "+") || token_is(t, "-"))
     	return 2;
 
-    if (strcmp(t.value, "==") == 0 ||
-     	strcmp(t.value, "!=") == 0 ||
-     	strcmp(t.value, ">=") == 0 ||
-     	strcmp(t.value, "<=") == 0 ||
-     	strcmp(t.value, "<") == 0  ||
-    	strcmp(t.value, ">") == 0)
+    if (token_is(t, "==") ||
+     	token_is(t, "!=") ||
+     	token_is(t, ">=") ||
+     	token_is(t, "<=") ||
+     	token_is(t, "<")  ||
+    	token_is(t, ">"))
      	return 1;
 
-    if (strcmp(t.value, "&&") == 0 || strcmp(t.value, "||") == 0)
+    if (token_is(t, "&&") || token_is(t, "||"))
     	return 0;
 
     return -1;
 }
 
-EXPR* parse_expression
-(uint *i, int precedence);
+/*
+	Node arrays grow together, a node is appended by bumping
+	expr_counter. Call arguments and array dims are parsed onto
+	expr_stack, nested lists stack above them, and a finished
+	list is moved into expr_items so it stays contiguous.
+*/
+
+uint8_t* expr_types = NULL;
+char** expr_text = NULL;
+expr_id* expr_left = NULL;
+expr_id* expr_right = NULL;
+uint expr_counter = 0;
+uint expr_size = 0;
+
+expr_id* expr_items = NULL;
+uint expr_items_counter = 0;
+uint expr_items_size = 0;
 
-EXPR* parse_primary(uint *i)
+_literal* expr_values = NULL;
+uint expr_values_counter = 0;
+uint expr_values_size = 0;
+
+expr_id* expr_stack = NULL;
+uint expr_stack_counter = 0;
+uint expr_stack_size = 0;
+
+void expr_init()
+{
+	expr_size = 256;
+	expr_types = malloc(sizeof(uint8_t) * expr_size);
+	expr_text = malloc(sizeof(char*) * expr_size);
+	expr_left = malloc(sizeof(expr_id) * expr_size);
+	expr_right = malloc(sizeof(expr_id) * expr_size);
+
+	// Node 0 is NO_EXPR
+	expr_types[0] = NODE_INT_LITERAL;
+	expr_text[0] = NULL;
+	expr_left[0] = NO_EXPR;
+	expr_right[0] = 0;
+	expr_counter = 1;
+}
+
+expr_id expr_node(const _node_type type, char* text, const expr_id left, const expr_id right)
+{
+	if (expr_counter == expr_size)
+	{
+		expr_size *= 2;
+		expr_types = realloc(expr_types, sizeof(uint8_t) * expr_size);
+		expr_text = realloc(expr_text, sizeof(char*) * expr_size);
+		expr_left = realloc(expr_left, sizeof(expr_id) * expr_size);
+		expr_right = realloc(expr_right, sizeof(expr_id) * expr_size);
+
+		if (expr_types == NULL || expr_text == NULL || expr_left == NULL || expr_right == NULL)
+		{
+			fprintf(stderr, "Parser realloc error\n");
+			exit(1);
+		}
+	}
+
+	expr_types[expr_counter] = type;
+	expr_text[expr_counter] = text;
+	expr_left[expr_counter] = left;
+	expr_right[expr_counter] = right;
+	return expr_counter++;
+}
+
+uint expr_value_push(const _literal* value)
+{
+	if (expr_values_counter == expr_values_size)
+	{
+		expr_values_size = expr_values_size == 0 ? 64 : expr_values_size * 2;
+		expr_values = realloc(expr_values, sizeof(_literal) * expr_values_size);
+	}
+
+	expr_values[expr_values_counter] = *value;
+	return expr_values_counter++;
+}
+
+void expr_push(const expr_id e)
+{
+	if (expr_stack_counter == expr_stack_size)
+	{
+		expr_stack_size = expr_stack_size == 0 ? 16 : expr_stack_size * 2;
+		expr_stack = realloc(expr_stack, sizeof(expr_id) * expr_stack_size);
+	}
+
+	expr_stack[expr_stack_counter++] = e;
+}
+
+// Moves the stack above base into expr_items, returns where it starts
+expr_id expr_list(const uint base)
+{
+	const uint count = expr_stack_counter - base;
+
+	if (expr_items_counter + count > expr_items_size)
+	{
+		while (expr_items_counter + count > expr_items_size)
+			expr_items_size = expr_items_size == 0 ? 64 : expr_items_size * 2;
+
+		expr_items = realloc(expr_items, sizeof(expr_id) * expr_items_size);
+	}
+
+	const expr_id list = expr_items_counter;
+	memcpy(expr_items + list, expr_stack + base, sizeof(expr_id) * count);
+	expr_items_counter += count;
+	expr_stack_counter = base;
+	return list;
+}
+
+expr_id parse_expression(uint *i, int precedence);
+
+expr_id parse_primary(uint *i)
 {
 	overflow_control(*i, WRONG_EXPRESSION);
-    _token tok = tokens[*i];
-    EXPR* node = malloc(sizeof(EXPR));
-    memset(node, 0, sizeof(EXPR));
+    // A copy, the ring moves on while call arguments are parsed
+    const _token tok = *token_at(*i);
 
 	// Handle negative expression
     if (tok.token_type == SYMBOL_MINUS)
     {
         (*i)++;
-        EXPR* operand = parse_primary(i);
-        EXPR* node = malloc(sizeof(EXPR));
-        memset(node, 0, sizeof(EXPR));
-        node->type = NODE_UNARY;
-        node->unary.op = strdup("-");
-        node->unary.value = operand;
-        return node;
+        expr_id operand = parse_primary(i);
+        return expr_node(NODE_UNARY, intern("-"), operand, NO_EXPR);
     }
 
     // Handle not expression
     if (tok.token_type == LOPERATOR_NOT)
     {
         (*i)++;
-        EXPR* operand = parse_primary(i);
-        EXPR* node = malloc(sizeof(EXPR));
-        memset(node, 0, sizeof(EXPR));
-        node->type = NODE_NOT;
-        node->unary.op = strdup("!");
-        node->unary.value = operand;
-        return node;
+        expr_id operand = parse_primary(i);
+        return expr_node(NODE_NOT, intern("!"), operand, NO_EXPR);
     }
 
     if (tok.token_group == _IDENTIFIER) 
     {
-        node->type = NODE_IDENTIFIER;
-        node->identifier = strdup(tok.value);
         (*i)++;
 
         // Call expression
-    	if (*i < tokens_counter && tokens[*i].token_type == SYMBOL_LPAREN)
+    	if (token_has(*i) && token_at(*i)->token_type == SYMBOL_LPAREN)
     	{
         	(*i)++;
+        	const uint base = expr_stack_counter;
 
-        	EXPR** args = NULL;
-        	int arg_count = 0;
-
-        	while (*i < tokens_counter && tokens[*i].token_type != SYMBOL_RPAREN)
+        	while (token_has(*i) && token_at(*i)->token_type != SYMBOL_RPAREN)
         	{
-            	args = realloc(args, sizeof(EXPR*) * (arg_count + 1));
-            	args[arg_count++] = parse_expression(i, 0);
+            	expr_push(parse_expression(i, 0));
 
-           		if (tokens[*i].token_type != SYMBOL_COMMA)
+           		if (token_at(*i)->token_type != SYMBOL_COMMA)
                 	break;
         		(*i)++;
         	}
 
-        	if (tokens[*i].token_type != SYMBOL_RPAREN)
-        		parser_error(tokens[*i - 1].line, tokens[*i - 1].column, WRONG_EXPRESSION);
+        	if (token_at(*i)->token_type != SYMBOL_RPAREN)
+        		parser_error(token_pos(*i - 1), WRONG_EXPRESSION);
         	(*i)++;
 
-        	EXPR* node = malloc(sizeof(EXPR));
-        	memset(node, 0, sizeof(EXPR));
-
-        	node->type = NODE_CALL;
-        	node->call.callee = strdup(tok.value);
-        	node->call.args = args;
-        	node->call.argc = arg_count;
-
-        	return node;
+        	const uint argc = expr_stack_counter - base;
+        	return expr_node(NODE_CALL, token_name(&tok), expr_list(base), argc);
     	}
 
 		// Array expression
-    	if (*i < tokens_counter && tokens[*i].token_type == SYMBOL_LBRACKET)
+    	if (token_has(*i) && token_at(*i)->token_type == SYMBOL_LBRACKET)
     	{
         	(*i)++;
-        	EXPR** dims = NULL;
-        	int dim_count = 0;
+        	const uint base = expr_stack_counter;
 
-        	while (*i < tokens_counter && tokens[*i].token_type != SYMBOL_LBRACKET)
+        	while (token_has(*i) && token_at(*i)->token_type != SYMBOL_LBRACKET)
         	{
-            	dims = realloc(dims, sizeof(EXPR*) * (dim_count + 1));
-            	dims[dim_count++] = parse_expression(i, 0);
+            	expr_push(parse_expression(i, 0));
 
-           		if (tokens[*i].token_type != SYMBOL_COMMA)
+           		if (token_at(*i)->token_type != SYMBOL_COMMA)
                 	break;
 
         		(*i)++;
         	}
 
-        	if (tokens[*i].token_type != SYMBOL_RBRACKET)
-        		parser_error(tokens[*i - 1].line, tokens[*i - 1].column, WRONG_EXPRESSION);
+        	if (token_at(*i)->token_type != SYMBOL_RBRACKET)
+        		parser_error(token_pos(*i - 1), WRONG_EXPRESSION);
         	(*i)++;
 
-        	EXPR* node = malloc(sizeof(EXPR));
-        	memset(node, 0, sizeof(EXPR));
-        	node->type = NODE_ARRAY;
-        	node->array.name = strdup(tok.value);
-        	node->array.dims = dims;
-        	node->array.dimc = dim_count;
-        	return node;
+        	const uint dimc = expr_stack_counter - base;
+        	return expr_node(NODE_ARRAY, token_name(&tok), expr_list(base), dimc);
     	}
  
-        return node;
+        return expr_node(NODE_IDENTIFIER, token_name(&tok), NO_EXPR, NO_EXPR);
     }
 
     if (tok.token_type == INTEGER_LITERAL)
     {
-        node->type = NODE_INT_LITERAL;
-        node->literal = strdup(tok.value);
         (*i)++;
-        return node;
+        return expr_node(NODE_INT_LITERAL, token_string(&tok), NO_EXPR,
+        	expr_value_push(token_literal(&tok)));
     }
 
     if (tok.token_type == SYMBOL_LPAREN)
     {
         (*i)++;
-        EXPR* inner = parse_expression(i, 0);
+        expr_id inner = parse_expression(i, 0);
 		overflow_control(*i, WRONG_EXPRESSION);
         (*i)++;
-        free(node);
         return inner;
     }
 
-	parser_error(tok.line, tok.column, WRONG_EXPRESSION);
+	parser_error(token_pos(*i), WRONG_EXPRESSION);
 }
 
-EXPR* parse_expression(uint *i, int precedence)
+expr_id parse_expression(uint *i, int precedence)
 {
-    EXPR* left = parse_primary(&(*i));
+    expr_id left = parse_primary(&(*i));
 
-    while (*i < tokens_counter && 
-    		isbinop(tokens[*i].value) && 
-    		get_precedence(tokens[*i]) >= precedence)
+    while (token_has(*i) && 
+    		token_at(*i)->token_group == BINARY_OP && 
+    		get_precedence(token_at(*i)) >= precedence)
     {
-        _token tok_op = tokens[*i];
-        char* op = strdup(tok_op.value);
+        const _token* tok_op = token_at(*i);
+        char* op = token_string(tok_op);
         uint op_prec = get_precedence(tok_op);
         (*i)++;
         
-        EXPR* right = parse_expression(i, op_prec + 1);
-        EXPR* bin = malloc(sizeof(EXPR));
-        memset(bin, 0, sizeof(EXPR));
-        bin->type = NODE_BINARY;
-        bin->binary.left = left;
-        bin->binary.right = right;
-        bin->binary.op = op;
-        left = bin;
+        expr_id right = parse_expression(i, op_prec + 1);
+        left = expr_node(NODE_BINARY, op, left, right);
     }
 
     return left;
 }
 
-void free_expr(EXPR* e)
-{
-    if (!e)
-    	return;
-
-    switch (e->type)
-    {
-        case NODE_BINARY:
-            free_expr(e->binary.left);
-            free_expr(e->binary.right);
-            free(e->binary.op);
-            break;
-        case NODE_IDENTIFIER:
-            free(e->identifier);
-            break;
-        case NODE_INT_LITERAL:
-            free(e->literal);
-            break;
-        case NODE_CALL:
-            for (uint i = 0; i < e->call.argc; i++)
-                free_expr(e->call.args[i]);
-        default:
-            break;
-    }
-
-    free(e);
-}
-
 AST parse_include(uint *i, uint c)
 {
 	AST result;
@@ -249,10 +291,10 @@ AST parse_include(uint *i, uint c)
 	result.seq = c;
 	result.type = INCLUDE;
 
-	if (tokens[*i + 1].token_type != STRING_LITERAL)
-		parser_error(tokens[*i].line, tokens[*i].column, UNEXPECTED_INCLUDE);
+	if (token_at(*i + 1)->token_type != STRING_LITERAL)
+		parser_error(token_pos(*i), UNEXPECTED_INCLUDE);
 
-	result.include.lib = tokens[*i + 1].value;
+	result.include.lib = token_string(token_at(*i + 1));
 	(*i)++;
 	return result;
 }
@@ -265,30 +307,32 @@ AST parse_macro(uint *i, uint c)
 	result.seq = c;
 	(*i)++;
 
-	if (tokens[*i].token_type != IDENTIFIER)
-		parser_error(tokens[*i].line, tokens[*i].column, UNEXPECTED_MACRO);
+	if (token_at(*i)->token_type != IDENTIFIER)
+		parser_error(token_pos(*i), UNEXPECTED_MACRO);
 
-	result.macro.name = tokens[*i].value;
+	result.macro.name = token_name(token_at(*i));
 	(*i)++;
 
-	char* temp = malloc(strlen(tokens[*i].value) + 1);
-	if (tokens[*i].token_type == SYMBOL_DOLAR)
+	if (token_at(*i)->token_type == SYMBOL_DOLAR)
 	{
 		result.macro.value = NULL;
 		return result;
 	}
-			
-	strcpy(temp, tokens[*i].value);
+
+	uint length = token_at(*i)->length;
+	char* temp = malloc(length + 1);
+	memcpy(temp, token_text(token_at(*i)), length);
 	(*i)++;
 
-	for (;tokens[*i].token_type != SYMBOL_DOLAR; (*i)++)
+	for (;token_at(*i)->token_type != SYMBOL_DOLAR; (*i)++)
 	{
 		overflow_control(*i, MISSING_DOLLAR);
-		temp = realloc(temp, strlen(temp) + strlen(tokens[*i].value) + 1);
-		strcat(temp, tokens[*i].value);
+		temp = realloc(temp, length + token_at(*i)->length + 1);
+		memcpy(temp + length, token_text(token_at(*i)), token_at(*i)->length);
+		length += token_at(*i)->length;
 	}
 
-	temp[strlen(temp)] = '\0';
+	temp[length] = '\0';
 	result.macro.value = temp;
 	return result;
 }
@@ -299,58 +343,56 @@ AST parse_var(uint *i, uint c)
 	result.type = VAR;
 	result.seq = c;
 
-	result.var.type = tokens[*i].value;
+	result.var.type = token_name(token_at(*i));
 	(*i)++;
 	
-	if (tokens[*i].token_type != IDENTIFIER)
-		parser_error(tokens[*i].line, tokens[*i].column, UNEXPECTED_VAR);
+	if (token_at(*i)->token_type != IDENTIFIER)
+		parser_error(token_pos(*i), UNEXPECTED_VAR);
 
-	result.var.name = tokens[*i].value;
+	result.var.name = token_name(token_at(*i));
 	(*i)++;
 	
-	if (tokens[*i].token_type == SYMBOL_LBRACKET)
+	if (token_at(*i)->token_type == SYMBOL_LBRACKET)
 	{
-		EXPR** dims = NULL;
 		(*i)++;
-		int dim_count = 0;
+		const uint base = expr_stack_counter;
 
-		for (;(*i) < tokens_counter; (*i)++)
+		for (;token_has(*i); (*i)++)
 		{
-			dims = realloc(dims, sizeof(EXPR*) * (dim_count + 1));
-			dims[dim_count++] = parse_expression(&(*i), 0);
+			expr_push(parse_expression(&(*i), 0));
 
-			if (tokens[*i].token_type != SYMBOL_COMMA)
+			if (token_at(*i)->token_type != SYMBOL_COMMA)
 				break;
 		}
 
-		if (tokens[*i].token_type != SYMBOL_RBRACKET)
-			parser_error(tokens[*i].line, tokens[*i].column, UNEXPECTED_VAR);
+		if (token_at(*i)->token_type != SYMBOL_RBRACKET)
+			parser_error(token_pos(*i), UNEXPECTED_VAR);
 
-		result.var.dimc = dim_count;
+		result.var.dimc = expr_stack_counter - base;
 		result.var.dim_key = 1;
-		result.var.dims = dims;
+		result.var.dims = expr_list(base);
 		(*i)++;
 	}
 	else
 		result.var.dim_key = 0;
 
-	if (tokens[*i].token_type == SYMBOL_ASSIGN)
+	if (token_at(*i)->token_type == SYMBOL_ASSIGN)
 	{
 		(*i)++;
 		result.var.value = parse_expression(&(*i), 0);
 		overflow_control(*i, MISSING_SEMICOLON);
 
-		if (tokens[*i].token_type != SYMBOL_SEMICOLON)
-			parser_error(tokens[*i].line, tokens[*i].column, MISSING_SEMICOLON);
+		if (token_at(*i)->token_type != SYMBOL_SEMICOLON)
+			parser_error(token_pos(*i), MISSING_SEMICOLON);
 
 		return result;
 	}
 
 	overflow_control(*i, MISSING_SEMICOLON);
-	result.var.value = NULL;
+	result.var.value = NO_EXPR;
 
-	if (tokens[*i].token_type != SYMBOL_SEMICOLON)
-		parser_error(tokens[*i].line, tokens[*i].column, MISSING_SEMICOLON);
+	if (token_at(*i)->token_type != SYMBOL_SEMICOLON)
+		parser_error(token_pos(*i), MISSING_SEMICOLON);
 
 	return result;
 }
@@ -365,8 +407,8 @@ AST parse_assignment(uint *i, uint c)
 	result.assignment.value = parse_expression(&(*i), 0);
 	overflow_control(*i, MISSING_SEMICOLON);
 
-	if (tokens[*i].token_type != SYMBOL_SEMICOLON)
-		parser_error(tokens[*i].line, tokens[*i].column, MISSING_SEMICOLON);
+	if (token_at(*i)->token_type != SYMBOL_SEMICOLON)
+		parser_error(token_pos(*i), MISSING_SEMICOLON);
 
 	return result;
 }
@@ -378,21 +420,16 @@ AST parse_call(uint *i, uint c)
 	result.type = CALL;
 	result.seq = c;
 
-	EXPR* inner_ast = parse_expression(&(*i), 0);
+	expr_id inner_ast = parse_expression(&(*i), 0);
 	overflow_control(*i, MISSING_SEMICOLON);
 
-	result.call.callee = inner_ast->call.callee;
-	result.call.argc = inner_ast->call.argc;
-	result.call.args = NULL;
-	
-	for (uint j = 0; j < inner_ast->call.argc; j++)
-	{
-		result.call.args = realloc(result.call.args, sizeof(EXPR*) * (j + 1));
-		result.call.args[j] = inner_ast->call.args[j];
-	}
+	// The statement takes the call node's argument list as it is
+	result.call.callee = expr_text[inner_ast];
+	result.call.args = expr_left[inner_ast];
+	result.call.argc = expr_right[inner_ast];
 
-	if (tokens[*i].token_type != SYMBOL_SEMICOLON)
-		parser_error(tokens[*i].line, tokens[*i].column, MISSING_SEMICOLON);
+	if (token_at(*i)->token_type != SYMBOL_SEMICOLON)
+		parser_error(token_pos(*i), MISSING_SEMICOLON);
 
 	return result;
 }
@@ -408,8 +445,8 @@ AST parse_return(uint *i, uint c)
 	result._return.value = parse_expression(&(*i), 0);
 	overflow_control(*i, MISSING_SEMICOLON);
 
-	if (tokens[*i].token_type != SYMBOL_SEMICOLON)
-		parser_error(tokens[*i].line, tokens[*i].column, MISSING_SEMICOLON);
+	if (token_at(*i)->token_type != SYMBOL_SEMICOLON)
+		parser_error(token_pos(*i), MISSING_SEMICOLON);
 
 	return result;
 }
@@ -422,26 +459,26 @@ AST parse_jumper(uint *i, uint c)
 	result.seq = c;
 	(*i)++;
 	
-	if (tokens[*i].token_type != SYMBOL_LPAREN)
-		parser_error(tokens[*i].line, tokens[*i].column, UNEXPECTED_JUMPER);
+	if (token_at(*i)->token_type != SYMBOL_LPAREN)
+		parser_error(token_pos(*i), UNEXPECTED_JUMPER);
 	(*i)++;
 	
 	result.jumper.condition = parse_expression(&(*i), 0);
 
-	if (tokens[*i].token_type != SYMBOL_RPAREN)
-		parser_error(tokens[*i].line, tokens[*i].column, UNEXPECTED_JUMPER);
+	if (token_at(*i)->token_type != SYMBOL_RPAREN)
+		parser_error(token_pos(*i), UNEXPECTED_JUMPER);
 	(*i)++;
 	
-	if (tokens[*i].token_type != IDENTIFIER)
-		parser_error(tokens[*i].line, tokens[*i].column, UNEXPECTED_JUMPER);
+	if (token_at(*i)->token_type != IDENTIFIER)
+		parser_error(token_pos(*i), UNEXPECTED_JUMPER);
 
-	result.jumper.label = tokens[*i].value;
+	result.jumper.label = token_name(token_at(*i));
 	(*i)++;
 
 	overflow_control(*i, MISSING_SEMICOLON);
 
-	if (tokens[*i].token_type != SYMBOL_SEMICOLON)
-		parser_error(tokens[*i].line, tokens[*i].column, MISSING_SEMICOLON);
+	if (token_at(*i)->token_type != SYMBOL_SEMICOLON)
+		parser_error(token_pos(*i), MISSING_SEMICOLON);
 
 	return result;
 }
@@ -454,18 +491,17 @@ AST parse_label(uint *i, uint c)
 	result.seq = c;
 	(*i)++;
 	
-	if (tokens[*i].token_type != IDENTIFIER)
-		parser_error(tokens[*i].line, tokens[*i].column, UNEXPECTED_LABEL);
+	if (token_at(*i)->token_type != IDENTIFIER)
+		parser_error(token_pos(*i), UNEXPECTED_LABEL);
 	
-	result.label.name = tokens[*i].value;
+	result.label.name = token_name(token_at(*i));
 	return result;
 }
 
 AST* ast;
 uint ast_counter = 0;
 char* scope;
-uint scope_line = 0;
-uint scope_column = 0;
+uint scope_position = NO_POSITION;
 
 AST parse_function(uint *i, uint c)
 {
@@ -475,21 +511,21 @@ AST parse_function(uint *i, uint c)
 	result.seq = c;
 	(*i)++;
 
-	if (tokens[*i].token_group != DTYPE)
-		parser_error(tokens[*i].line, tokens[*i].column, UNEXPECTED_FUNCTION);
+	if (token_at(*i)->token_group != DTYPE)
+		parser_error(token_pos(*i), UNEXPECTED_FUNCTION);
 
-	result.function.type = tokens[*i].value;
+	result.function.type = token_name(token_at(*i));
 	(*i)++;
 
-	if (tokens[*i].token_type != IDENTIFIER)
-		parser_error(tokens[*i].line, tokens[*i].column, UNEXPECTED_FUNCTION);
+	if (token_at(*i)->token_type != IDENTIFIER)
+		parser_error(token_pos(*i), UNEXPECTED_FUNCTION);
 
-	result.function.name = tokens[*i].value;
-	scope = strdup(tokens[*i].value);
+	result.function.name = token_name(token_at(*i));
+	scope = result.function.name;
 	(*i)++;
 
-	if (tokens[*i].token_type != SYMBOL_LPAREN)
-		parser_error(tokens[*i].line, tokens[*i].column, UNEXPECTED_FUNCTION);
+	if (token_at(*i)->token_type != SYMBOL_LPAREN)
+		parser_error(token_pos(*i), UNEXPECTED_FUNCTION);
 	(*i)++;
 
 	/* PARSE FUNCTION PARAMETERS */
@@ -497,48 +533,46 @@ AST parse_function(uint *i, uint c)
 	result.function.args = NULL;
 	uint argc = 0;
 
-	while (tokens[*i].token_type != SYMBOL_RPAREN)
+	while (token_at(*i)->token_type != SYMBOL_RPAREN)
 	{
-		if (tokens[*i].token_type == SYMBOL_COMMA)
+		if (token_at(*i)->token_type == SYMBOL_COMMA)
 			(*i)++;
 
-		if (tokens[*i].token_group == DTYPE)
+		if (token_at(*i)->token_group == DTYPE)
 		{	
 			result.function.args = realloc(result.function.args, 
 				sizeof(*result.function.args) * (argc + 1));
-			result.function.args[argc].type = tokens[*i].value;
+			result.function.args[argc].type = token_name(token_at(*i));
 			(*i)++;
 
-			if (tokens[*i].token_type == IDENTIFIER)
+			if (token_at(*i)->token_type == IDENTIFIER)
 			{
-				result.function.args[argc].name = tokens[*i].value;
+				result.function.args[argc].name = token_name(token_at(*i));
 				(*i)++;
 				argc++;
 				continue;
 			}
 
-			parser_error(tokens[*i].line, tokens[*i].column, UNEXPECTED_FUNCTION);
+			parser_error(token_pos(*i), UNEXPECTED_FUNCTION);
 		}
 
-		parser_error(tokens[*i].line, tokens[*i].column, UNEXPECTED_FUNCTION);
+		parser_error(token_pos(*i), UNEXPECTED_FUNCTION);
 	}
 
 	result.function.argc = argc;
 	(*i)++;
 
-	if (tokens[*i].token_type != SYMBOL_LBRACE)
-		parser_error(tokens[*i].line, tokens[*i].column, UNEXPECTED_FUNCTION);
+	if (token_at(*i)->token_type != SYMBOL_LBRACE)
+		parser_error(token_pos(*i), UNEXPECTED_FUNCTION);
 
 	return result;
 }
 
 #define AST_NODE_COMMIT() \
     do { \
-        ast[ast_counter].scope = strdup(scope); \
-        ast[ast_counter].line = tokens[i].line; \
-        ast[ast_counter].column = tokens[i].column; \
-        ast[ast_counter].scpline = scope_line; \
-        ast[ast_counter].scpcolumn = scope_column; \
+        ast[ast_counter].scope = scope; \
+        ast[ast_counter].position = token_pos(i); \
+        ast[ast_counter].scope_position = scope_position; \
         ast_counter++; \
         ast = realloc(ast, sizeof(AST) * ast_counter * 2); \
     } while(0)
@@ -546,31 +580,28 @@ AST parse_function(uint *i, uint c)
 void parser_main()
 {
 	ast = malloc(sizeof(AST) * 2);
-	scope = malloc(255);
-	strcpy(scope, "global");
+	expr_init();
+	scope = global_scope;
 
-	for (uint i = 0; i < tokens_counter; i++)
+	for (uint i = 0; token_has(i); i++)
 	{
 		// If brace is closed then clean the scope.
-		if (strcmp(scope, "global") != 0 && tokens[i].token_type == SYMBOL_RBRACE)
+		if (scope != global_scope && token_at(i)->token_type == SYMBOL_RBRACE)
 		{
-			strcpy(scope, "global");
+			scope = global_scope;
 			continue;
 		}
 
 		/* PARSE DATA TYPE */
 
-		const uint tmp_line = tokens[i].line;
-		const uint tmp_column = tokens[i].column;
+		const uint tmp_position = token_pos(i);
 
-		if (tokens[i].token_group == DTYPE)
+		if (token_at(i)->token_group == DTYPE)
 		{	
 			ast[ast_counter] = parse_var(&i, ast_counter);
-			ast[ast_counter].scope = strdup(scope);
-			ast[ast_counter].line = tmp_line;
-			ast[ast_counter].column = tmp_column;
-			ast[ast_counter].scpline = scope_line;
-			ast[ast_counter].scpcolumn = scope_column;
+			ast[ast_counter].scope = scope;
+			ast[ast_counter].position = tmp_position;
+			ast[ast_counter].scope_position = scope_position;
 			ast_counter++;
 			ast = realloc(ast, sizeof(AST) * ast_counter * 2);
 			continue;
@@ -579,16 +610,17 @@ void parser_main()
 		/* PARSE IDENTIFIER ASSIGNMENT */
 
 		//overflow_control(i, MISSING_ARG);
-		if (tokens[i].token_type == IDENTIFIER && 
-			(tokens[i + 1].token_type == SYMBOL_ASSIGN || 
-			tokens[i + 1].token_type == SYMBOL_LBRACKET))
+		if (token_at(i)->token_type == IDENTIFIER && 
+			(token_at(i + 1)->token_type == SYMBOL_ASSIGN || 
+			token_at(i + 1)->token_type == SYMBOL_LBRACKET))
 		{
-			char* var_name = tokens[i].value;
-			EXPR** dims = NULL;
+			char* var_name = token_name(token_at(i));
+			const uint base = expr_stack_counter;
+			expr_id dims = NO_EXPR;
 			uint dim_count = 0;
 			bool dim_key = 0;
 
-			if (tokens[i + 1].token_type == SYMBOL_LBRACKET)
+			if (token_at(i + 1)->token_type == SYMBOL_LBRACKET)
 			{
 				/*
 					n[array_dims] = expression;
@@ -596,19 +628,21 @@ void parser_main()
 					  |- i+2
 				*/
 				i+=2;
-				while (i < tokens_counter && tokens[i].token_type != SYMBOL_LBRACKET)
+				while (token_has(i) && token_at(i)->token_type != SYMBOL_LBRACKET)
 				{
-            		dims = realloc(dims, sizeof(EXPR*) * (dim_count + 1));
-            		dims[dim_count++] = parse_expression(&i, 0);
+            		expr_push(parse_expression(&i, 0));
 
-           			if (tokens[i].token_type != SYMBOL_COMMA)
+           			if (token_at(i)->token_type != SYMBOL_COMMA)
                 		break;
 					i++;
 				}
 
-				if (tokens[i].token_type != SYMBOL_RBRACKET)
-					parser_error(tokens[i - 1].line, tokens[i - 1].column, WRONG_EXPRESSION);
-				if (tokens[i + 1].token_type != SYMBOL_ASSIGN)
+				dim_count = expr_stack_counter - base;
+				dims = expr_list(base);
+
+				if (token_at(i)->token_type != SYMBOL_RBRACKET)
+					parser_error(token_pos(i - 1), WRONG_EXPRESSION);
+				if (token_at(i + 1)->token_type != SYMBOL_ASSIGN)
 					break;
 
 				i++;
@@ -617,7 +651,7 @@ void parser_main()
 			else 
 				i++;
 
-			if (tokens[i].token_type != SYMBOL_ASSIGN)
+			if (token_at(i)->token_type != SYMBOL_ASSIGN)
 				break;
 			i++;
 
@@ -632,7 +666,7 @@ void parser_main()
 
 		/* PARSE CALL */
 		overflow_control(i, MISSING_ARG);
-		if (tokens[i].token_type == IDENTIFIER && tokens[i + 1].token_type == SYMBOL_LPAREN)
+		if (token_at(i)->token_type == IDENTIFIER && token_at(i + 1)->token_type == SYMBOL_LPAREN)
 		{
 			ast[ast_counter] = parse_call(&i, ast_counter);
 			AST_NODE_COMMIT();
@@ -640,7 +674,7 @@ void parser_main()
 		}
 
 		/* PARSE */
-		switch (tokens[i].token_type)
+		switch (token_at(i)->token_type)
 		{
 			case KEYWORD_INCLUDE:
 				ast[ast_counter] = parse_include(&i, ast_counter);
@@ -663,19 +697,34 @@ void parser_main()
 				AST_NODE_COMMIT();
 				break;
 			case KEYWORD_FUNCTION:
-				if (strcmp(scope, "global") != 0)
-					parser_error(tokens[i].line, tokens[i].column, UNEXPECTED_FUNCTION);
+				if (scope != global_scope)
+					parser_error(token_pos(i), UNEXPECTED_FUNCTION);
 
 				ast[ast_counter] = parse_function(&i, ast_counter);
 				AST_NODE_COMMIT();
-				scope_line = tokens[i].line;
-				scope_column = tokens[i].column;
+				scope_position = token_pos(i);
 				break;				
 			default:
-				parser_error(tokens[i].line, tokens[i].column, UNEXPECTED);
+				parser_error(token_pos(i), UNEXPECTED);
 		}
 	}
 
-	if (strcmp(scope, "global") != 0)
-		parser_error(scope_line, scope_column, UNEXPECTED_FUNCTION);
+	if (scope != global_scope)
+		parser_error(scope_position, UNEXPECTED_FUNCTION);
+}
+
+// The tree is not needed after IR, all of it goes at once
+void parser_free()
+{
+	free(ast);
+	free(expr_types);
+	free(expr_text);
+	free(expr_left);
+	free(expr_right);
+	free(expr_items);
+	free(expr_values);
+	free(expr_stack);
+	ast = NULL;
+	ast_counter = 0;
+	expr_counter = 0;
 }
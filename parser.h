@@ -2,6 +2,7 @@
 #define PARSER_H
 #include <stdlib.h>
 #include <stdbool.h>
+#include "common.h"
 
 typedef enum 
 {
@@ -31,59 +32,57 @@ typedef enum
 }
 _AST_TYPE;
 
-typedef struct EXPR
+/*
+	Expression nodes are kept in parallel arrays and referred
+	to by their index, 0 is no expression. The text of a node is
+	its name, operator or literal text, interned. Operands are
+	by node type:
+
+	  NODE_BINARY        left and right operand
+	  NODE_UNARY, NOT    operand in left
+	  NODE_CALL, ARRAY   first argument or dim in expr_items, and count
+	  NODE_INT_LITERAL   index of its value in expr_values in right
+
+	Nodes are only appended, they are freed all at once.
+*/
+
+typedef uint expr_id;
+
+#define NO_EXPR 0
+
+extern uint8_t* expr_types; // _node_type
+extern char** expr_text;
+extern expr_id* expr_left;
+extern expr_id* expr_right;
+extern uint expr_counter;
+
+extern expr_id* expr_items;
+extern _literal* expr_values;
+
+static inline _node_type expr_type(const expr_id e)
 {
-    _node_type type;
-
-    union
-    {
-        char* literal;
-        char* identifier;
-
-        struct
-        {
-            struct EXPR* left;
-            struct EXPR* right;
-            char* op;
-        }
-        binary;
-
-        struct
-        {
-        	char* op;
-        	struct EXPR* value;
-        }
-        unary;
-
-        struct
-        {
-            char* callee;
-            struct EXPR** args;
-            uint argc;
-        }
-        call;
-
-        struct
-        {
-            char* name;
-            struct EXPR** dims;
-            uint dimc;
-        }
-        array;
-    };
+	return expr_types[e];
+}
+
+// Argument or dim k of a list that starts at list
+static inline expr_id expr_item(const expr_id list, const uint k)
+{
+	return expr_items[list + k];
+}
+
+static inline const _literal* expr_value(const expr_id e)
+{
+	return &expr_values[expr_right[e]];
 }
-EXPR;
 
 typedef struct
 {
 	_AST_TYPE type;
 	uint seq;
 
-	uint line;
-	uint column;
-
-	uint scpline;
-	uint scpcolumn;
+	// Offsets in the source, resolved by position_at
+	uint position;
+	uint scope_position;
 	char* scope;
 
 	union
@@ -118,21 +117,21 @@ typedef struct
 		struct
 		{
             char* callee;
-            struct EXPR** args;
+            expr_id args; // first in expr_items
             uint argc;
 		}
 		call;
 
 		struct
 		{
-			struct EXPR* value;
+			expr_id value;
 		}
 		_return;
 
 		struct
 		{
 			char* label;
-			struct EXPR* condition;
+			expr_id condition;
 		}
 		jumper;
 
@@ -146,10 +145,10 @@ typedef struct
 		{
 			char* type;
 			char* name;
-			struct EXPR* value;
+			expr_id value;
 
 			bool dim_key;
-			struct EXPR** dims;
+			expr_id dims; // first in expr_items
 			uint dimc;
 		}
 		var;
@@ -158,10 +157,10 @@ typedef struct
 		{
 			char* type;
 			char* name;
-			struct EXPR* value;
+			expr_id value;
 
 			bool dim_key;
-			struct EXPR** dims;
+			expr_id dims; // first in expr_items
 			uint dimc;
 		}
 		assignment;
@@ -173,5 +172,6 @@ extern AST* ast;
 extern uint ast_counter;
 
 void parser_main();
+void parser_free();
 
 #endif
@@ -26,350 +26,1301 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <fcntl.h>
 
 /*
-	top holds chars from the start of 
-	the root file up to the include point
-
-	middle holds chars from the include 
-	point to the end of the included file
-
-	bottom: holds chars from the end of the 
-	included file to the end of the root file
+	The expanded translation unit is kept as a piece table.
+	Every piece points into an already loaded buffer (the root
+	file, an included file or a literal), so an INCLUDE is
+	spliced in by reference instead of rebuilding the text
+	around it. The pieces are joined only once, for the lexer.
 */
 
-char* top;
-char* middle;
-char* bottom;
+typedef struct
+{
+	const char* data;
+	uint length;
+}
+pp_piece;
 
-uint middle_size = 128;
-uint topbuffer_size = 128;
-uint middlebuffer_size = 128;
-uint bottombuffer_size = 128;
+pp_piece* pieces = NULL;
+uint pieces_counter = 0;
+uint pieces_size = 0;
 
 char* root_file;
 uint rf_counter = 0;
 
-char* include_handler(char* rf, uint rf_counter, uint i)
-{
-    char* for_top = malloc(128);
-    uint c = 0;
-    char* for_middle = malloc(middlebuffer_size);
-    uint d = 0;
-    i++;
-
-    for (;i < rf_counter && rf[i] != '"'; i++)
-    {
-        if (rf[i] == ' ')
-        {
-            if ((c + 1) % 128 == 0) 
-            	for_top = realloc(for_top, (c + 1) * 2);
-
-            for_top[c] = rf[i];
-            c++;
-            continue;
-        }
-
-        return NULL;
-    }
-
-    for_top[c] = rf[i];
-	c++;
-    i++;
-
-    for (;i < rf_counter && rf[i] != '"'; i++)
-    {
-        if ((c + 1) % 128 == 0)
-        {
-        	for_top = realloc(for_top, (c + 1) * 2);
-        	for_middle = realloc(for_middle, (c + 1) * 2);
-        }
-
-        for_top[c] = rf[i];
-		c++;
-
-        if (d + 1 >= middlebuffer_size)
-        {
-            middlebuffer_size *= 2;
-            char* tmp = realloc(for_middle, middlebuffer_size);
-            for_middle = tmp;
-        }
-
-        for_middle[d] = rf[i];
-        d++;
-    }
-    
-    for_top[c] = rf[i];
-    c++;
-    for_top[c] = '\0';
-	for_middle[d] = '\0';
-    middle = open_buffer(for_middle, &middle_size);
-
-	if (middle == NULL) 
+// Set when an include cannot be resolved, stops the expansion
+bool pp_stop = 0;
+
+/*
+	Source map of the expanded translation unit. An entry is
+	added wherever the expanded text switches between files,
+	so a line is resolved by binary search instead of keeping
+	a "file:line" string for every line.
+*/
+
+char** source_files = NULL;
+uint source_files_counter = 0;
+
+source_map_entry* source_map = NULL;
+uint source_map_counter = 0;
+uint source_map_size = 0;
+
+// Files the translation unit depends on, for --Save deps
+const char** dependencies = NULL;
+uint dependencies_counter = 0;
+
+// Expanded offset and line at the end of the emitted pieces
+uint pp_offset = 0;
+uint pp_line = 1;
+
+/*
+	Spans of included files in the expanded source, one for
+	each run of a file's text between its own includes. The
+	lexer takes the tokens of a span from the token cache by
+	its key instead of lexing the text again.
+*/
+
+include_span* include_spans = NULL;
+uint include_spans_counter = 0;
+uint include_spans_size = 0;
+
+uint add_source_file(const char* name)
+{
+	source_files = realloc(source_files, sizeof(char*) * (source_files_counter + 1));
+	source_files[source_files_counter] = (char*)name;
+	return source_files_counter++;
+}
+
+void map_enter(uint file, uint line)
+{
+	// Replace an entry that has no text behind it
+	if (source_map_counter > 0 && source_map[source_map_counter - 1].offset == pp_offset)
+		source_map_counter--;
+
+	if (source_map_counter + 1 > source_map_size)
+	{
+		source_map_size = source_map_size == 0 ? 64 : source_map_size * 2;
+		source_map = realloc(source_map, sizeof(source_map_entry) * source_map_size);
+	}
+
+	source_map[source_map_counter].offset = pp_offset;
+	source_map[source_map_counter].exp_line = pp_line;
+	source_map[source_map_counter].file = file;
+	source_map[source_map_counter].line = line;
+	source_map_counter++;
+}
+
+const char* source_location(uint exp_line, uint *line)
+{
+	if (source_map_counter == 0 || exp_line == 0)
 		return NULL;
 
-	if (middle[strlen(middle) - 2] != '@')
-		prep_error(for_middle, 0, 0, END_SYMBOL);
+	// Last entry starting at or before exp_line
+	uint low = 0;
+	uint high = source_map_counter;
 
-    free(for_top);
-	free(for_middle);
-    return for_top;
+	while (high - low > 1)
+	{
+		uint mid = (low + high) / 2;
+
+		if (source_map[mid].exp_line <= exp_line)
+			low = mid;
+		else
+			high = mid;
+	}
+
+	(*line) = source_map[low].line + (exp_line - source_map[low].exp_line);
+	return source_files[source_map[low].file];
+}
+
+uint count_lines(const char* data, uint length)
+{
+	uint lines = 0;
+	const char* end = data + length;
+
+	while ((data = memchr(data, '\n', end - data)) != NULL)
+	{
+		lines++;
+		data++;
+	}
+
+	return lines;
 }
 
-void sync_top(char* synced, uint *i)
+void emit_piece(const char* data, uint length)
+{
+	if (length == 0)
+		return;
+
+	pp_offset += length;
+	pp_line += count_lines(data, length);
+
+	// Continue the last piece if the span is contiguous
+	if (pieces_counter > 0 &&
+		pieces[pieces_counter - 1].data + pieces[pieces_counter - 1].length == data)
+	{
+		pieces[pieces_counter - 1].length += length;
+		return;
+	}
+
+	if (pieces_counter + 1 > pieces_size)
+	{
+		pieces_size = pieces_size == 0 ? 64 : pieces_size * 2;
+		pieces = realloc(pieces, sizeof(pp_piece) * pieces_size);
+	}
+
+	pieces[pieces_counter].data = data;
+	pieces[pieces_counter].length = length;
+	pieces_counter++;
+}
+
+// Emits [from, from + length) of an included file as a span
+void emit_span(const char* rf, uint from, uint length, uint64_t hash)
+{
+	if (length == 0)
+		return;
+
+	if (include_spans_counter + 1 > include_spans_size)
+	{
+		include_spans_size = include_spans_size == 0 ? 16 : include_spans_size * 2;
+		include_spans = realloc(include_spans, sizeof(include_span) * include_spans_size);
+	}
+
+	include_spans[include_spans_counter].offset = pp_offset;
+	include_spans[include_spans_counter].length = length;
+	include_spans[include_spans_counter].key = (hash * 31 + from) * 31 + length;
+	include_spans_counter++;
+
+	emit_piece(rf + from, length);
+}
+
+char* materialize_pieces(uint *size)
+{
+	uint total = 0;
+
+	for (uint i = 0; i < pieces_counter; i++)
+		total += pieces[i].length;
+
+	char* result = malloc(total + 1);
+	uint c = 0;
+
+	for (uint i = 0; i < pieces_counter; i++)
+	{
+		memcpy(result + c, pieces[i].data, pieces[i].length);
+		c += pieces[i].length;
+	}
+
+	result[total] = '\0';
+	(*size) = total;
+	return result;
+}
+
+char* include_handler(const char* rf, uint rf_counter, uint i, uint *end)
+{
+	/*
+		i points to the last char of "INCLUDE",
+		only spaces are allowed until the opening quote.
+		end is set to the index of the closing quote.
+	*/
+
+	i++;
+
+	for (;i < rf_counter && rf[i] != '"'; i++)
+	{
+		if (rf[i] != ' ')
+			return NULL;
+	}
+
+	uint start = i + 1;
+
+	for (i = start; i < rf_counter && rf[i] != '"'; i++){}
+
+	if (i >= rf_counter)
+		return NULL;
+
+	(*end) = i;
+	return strndup(rf + start, i - start);
+}
+
+bool include_at(const char* rf, uint rf_counter, uint i, uint word_from)
 {
 	/*
-		add remaining chars to top 
-		buffer after detected "INCLUDE" 
+		True if the 'I' at i starts an INCLUDE word. Words
+		are split on ' ' and '\n' only, word_from is the
+		first index after a skipped directive.
 	*/
-    (*i)++;
 
-    for (uint c = 0; synced[c] != '\0'; c++)
-    {
-        if (*i + 1 >= topbuffer_size)
-        {
-            topbuffer_size *= 2;
-            char* tmp = realloc(top, topbuffer_size);
-            top = tmp;
-        }
+	if (i != word_from && rf[i - 1] != ' ' && rf[i - 1] != '\n')
+		return 0;
+
+	return rf_counter - i >= 7 && memcmp(rf + i, "INCLUDE", 7) == 0;
+}
+
+/*
+	Include search. A quoted path is tried as written (from the
+	working directory), then under every -I directory in order.
+	Each directory is listed once per run into an index, so
+	probing the search paths costs no open() or stat() calls.
+	Resolved paths are kept for the semantic INCLUDE check.
+*/
+
+str_table indexed_dirs;
+str_table dir_entries;
+str_table resolved_includes;
 
-        top[*i] = synced[c];
-        (*i)++;
-    }
+bool index_exists(const char* path)
+{
+	const char* slash = strrchr(path, '/');
+	char* dir = slash == NULL ? strdup(".") : strndup(path, slash == path ? 1 : slash - path);
+	const char* base = slash == NULL ? path : slash + 1;
 
-    if (*i + 2 >= topbuffer_size)
-    {
-        topbuffer_size *= 2;
-        top = realloc(top, topbuffer_size);
-    }
+	if (str_table_find(&indexed_dirs, dir) == NULL)
+	{
+		str_table_put(&indexed_dirs, dir, dir);
+		DIR* handle = opendir(dir);
+		struct dirent* ent;
 
-    top[*i] = '\n';
-    top[*i + 1] = '\0';
+		while (handle != NULL && (ent = readdir(handle)) != NULL)
+		{
+			if (ent->d_type == DT_DIR)
+				continue;
+
+			uint length = strlen(dir) + strlen(ent->d_name) + 2;
+			char* key = malloc(length);
+			snprintf(key, length, "%s/%s", dir, ent->d_name);
+			str_table_put(&dir_entries, key, key);
+			free(key);
+		}
+
+		if (handle != NULL)
+			closedir(handle);
+	}
+
+	uint length = strlen(dir) + strlen(base) + 2;
+	char* key = malloc(length);
+	snprintf(key, length, "%s/%s", dir, base);
+
+	bool exists = str_table_find(&dir_entries, key) != NULL;
+	free(key);
+	free(dir);
+	return exists;
 }
 
-void get_bottom(char* rf, uint start, uint stop)
+const char* include_resolve(const char* path)
 {
-    uint l = 0;
+	void** found = str_table_find(&resolved_includes, path);
 
-    for (uint c = start + 1; c < stop; c++)
-    {
-        if (l + 1 >= bottombuffer_size)
-        {
-            bottombuffer_size *= 2;
-            char* tmp = realloc(bottom, bottombuffer_size);
-            bottom = tmp;
-        }
+	if (found != NULL)
+		return *found;
 
-        bottom[l] = rf[c];
-        l++;
-    }
+	char* resolved = NULL;
 
-    bottom[l] = '\0';
+	if (index_exists(path))
+		resolved = strdup(path);
+
+	for (uint i = 0; resolved == NULL && path[0] != '/' && i < arg_flagref.include_paths_counter; i++)
+	{
+		uint length = strlen(arg_flagref.include_paths[i]) + strlen(path) + 2;
+		char* candidate = malloc(length);
+		snprintf(candidate, length, "%s/%s", arg_flagref.include_paths[i], path);
+
+		if (index_exists(candidate))
+			resolved = candidate;
+		else
+			free(candidate);
+	}
+
+	str_table_put(&resolved_includes, path, resolved);
+	return resolved;
 }
 
-void clear_posstrg()
+/*
+	Per run include cache. Entries are found by the canonical
+	path and checked against inode and mtime, so a library
+	pulled in by many files is read and validated only once.
+	Files are included once by default; an INCLUDE of a file
+	(or of identical content) that is already spliced is kept
+	in the source but not expanded again.
+*/
+
+typedef struct
 {
-    clear_buffer(middle, &middlebuffer_size);
-    clear_buffer(bottom, &bottombuffer_size);
+	char* path;
+	dev_t dev;
+	ino_t ino;
+	struct timespec mtime;
 
-    middlebuffer_size = 128;
-    bottombuffer_size = 128;
+	char* buffer;
+	uint size;
+	uint64_t hash;
 
-    middle = malloc(middlebuffer_size);
-    bottom = malloc(bottombuffer_size);
+	bool valid;
+	bool spliced;
 }
+pp_include;
 
+pp_include* includes = NULL;
+uint includes_counter = 0;
 
-uint8_t delimiter_key = 0;
-uint8_t commentline_key = 0;
-uint8_t blockcomment_key = 0;
+uint* include_slots = NULL;
+uint include_slots_size = 0;
 
-void pass_scan(char chr, char* str)
+void include_slots_grow()
 {
-	if ( (commentline_key == 0 && delimiter_key == 0) && chr == '"')
+	include_slots_size = include_slots_size == 0 ? 64 : include_slots_size * 2;
+	free(include_slots);
+	include_slots = malloc(sizeof(uint) * include_slots_size);
+	memset(include_slots, 0xff, sizeof(uint) * include_slots_size);
+
+	for (uint i = 0; i < includes_counter; i++)
 	{
-		delimiter_key = 1;
+		uint slot = fnv_hash(includes[i].path, strlen(includes[i].path)) & (include_slots_size - 1);
+
+		while (include_slots[slot] != UINT_MAX)
+			slot = (slot + 1) & (include_slots_size - 1);
+
+		include_slots[slot] = i;
+	}
+}
+
+void include_read(pp_include* inc)
+{
+	inc->buffer = map_buffer(inc->path, &inc->size);
+
+	if (inc->buffer == NULL)
 		return;
+
+	inc->hash = fnv_hash(inc->buffer, inc->size);
+	inc->valid = inc->size >= 2 && inc->buffer[inc->size - 2] == '@';
+}
+
+pp_include* include_entry(char* canonical, const struct stat* st, bool *fresh)
+{
+	/*
+		Finds or adds the entry of a canonical path.
+		fresh is set when the buffer has to be (re)loaded,
+		canonical is owned by the cache afterwards.
+	*/
+
+	(*fresh) = 0;
+
+	if ((includes_counter + 1) * 2 > include_slots_size)
+		include_slots_grow();
+
+	uint slot = fnv_hash(canonical, strlen(canonical)) & (include_slots_size - 1);
+
+	for (;include_slots[slot] != UINT_MAX; slot = (slot + 1) & (include_slots_size - 1))
+	{
+		pp_include* inc = &includes[include_slots[slot]];
+
+		if (strcmp(inc->path, canonical) != 0)
+			continue;
+
+		free(canonical);
+
+		// File changed on disk during the run
+		if (inc->dev != st->st_dev || inc->ino != st->st_ino ||
+			inc->mtime.tv_sec != st->st_mtim.tv_sec || inc->mtime.tv_nsec != st->st_mtim.tv_nsec)
+		{
+			// Spliced buffers stay mapped, pieces still point into them
+			if (inc->buffer != NULL && !inc->spliced)
+				unmap_buffer(inc->buffer, inc->size);
+
+			inc->buffer = NULL;
+			inc->dev = st->st_dev;
+			inc->ino = st->st_ino;
+			inc->mtime = st->st_mtim;
+			(*fresh) = 1;
+		}
+
+		return inc;
+	}
+
+	includes = realloc(includes, sizeof(pp_include) * (includes_counter + 1));
+	pp_include* inc = &includes[includes_counter];
+	memset(inc, 0, sizeof(pp_include));
+
+	inc->path = canonical;
+	inc->dev = st->st_dev;
+	inc->ino = st->st_ino;
+	inc->mtime = st->st_mtim;
+	(*fresh) = 1;
+
+	include_slots[slot] = includes_counter;
+	includes_counter++;
+
+	return inc;
+}
+
+pp_include* include_lookup(const char* path)
+{
+	char* canonical = realpath(path, NULL);
+	struct stat st;
+	bool fresh = 0;
+
+	if (canonical == NULL || stat(canonical, &st) != 0)
+	{
+		free(canonical);
+		return NULL;
 	}
-	if (delimiter_key == 1 && chr == '"')
-		delimiter_key = 0;
 
-	if ( (delimiter_key == 0 && commentline_key == 0) && chr == '~')
+	pp_include* inc = include_entry(canonical, &st, &fresh);
+
+	if (fresh)
+		include_read(inc);
+
+	return inc->buffer == NULL ? NULL : inc;
+}
+
+bool include_once(const pp_include* inc)
+{
+	/*
+		True if this file, or a file with
+		the same content, is already spliced
+	*/
+
+	for (uint i = 0; i < includes_counter; i++)
 	{
-		commentline_key = 1;
-		return;
+		if (!includes[i].spliced || includes[i].hash != inc->hash)
+			continue;
+
+		if (&includes[i] == inc || (includes[i].size == inc->size &&
+			memcmp(includes[i].buffer, inc->buffer, inc->size) == 0))
+			return 1;
 	}
-	if (commentline_key == 1 && chr == '\n')
-		commentline_key = 0;
 
-	if ((delimiter_key == 0 && commentline_key == 0) && strcmp(str, "/~") == 0)
+	return 0;
+}
+
+/*
+	Include prefetch. Before expansion the INCLUDE paths are
+	collected level by level (root, then the files it pulls in,
+	and so on) and every level is loaded on a small pool of
+	threads. Workers only resolve, map, hash and validate;
+	entries are added to the cache by the main thread, so the
+	splice itself finds every buffer already resident.
+*/
+
+typedef struct
+{
+	char* path;
+	uint64_t path_hash;
+
+	// Filled by the workers
+	char* canonical;
+	struct stat st;
+	pp_include loaded;
+}
+pp_prefetch;
+
+pp_prefetch* prefetch_jobs = NULL;
+uint prefetch_counter = 0;
+uint prefetch_next = 0;
+uint prefetch_end = 0;
+
+void prefetch_add(char* literal)
+{
+	// Resolved here, the search index is not shared with the workers
+	const char* resolved = include_resolve(literal);
+	free(literal);
+
+	if (resolved == NULL)
+		return;
+
+	char* path = strdup(resolved);
+	uint64_t hash = fnv_hash(path, strlen(path));
+
+	for (uint i = 0; i < prefetch_counter; i++)
 	{
-		if (blockcomment_key == 0)
+		if (prefetch_jobs[i].path_hash == hash && strcmp(prefetch_jobs[i].path, path) == 0)
 		{
-			blockcomment_key = 1;
-			return;	
+			free(path);
+			return;
 		}
 	}
-	if (blockcomment_key == 1 && strcmp(str, "~/") == 0)
-		commentline_key = 0;
+
+	prefetch_jobs = realloc(prefetch_jobs, sizeof(pp_prefetch) * (prefetch_counter + 1));
+	memset(&prefetch_jobs[prefetch_counter], 0, sizeof(pp_prefetch));
+	prefetch_jobs[prefetch_counter].path = path;
+	prefetch_jobs[prefetch_counter].path_hash = hash;
+	prefetch_counter++;
 }
 
-void analyzer(char* converted)
+void prefetch_scan(const char* rf, uint rf_counter)
 {
-	root_file = open_buffer(converted, &rf_counter);
-	char* prep_buffer = malloc(128);
-	uint pb_size = 0;
+	/*
+		Same rules as expand, with its own string and
+		comment state. Only a hint, the real directive
+		is still parsed by expand.
+	*/
 
-	top = malloc(topbuffer_size);
-	middle = malloc(middlebuffer_size);
-	bottom = malloc(bottombuffer_size);
+	bool string = 0;
+	bool comment = 0;
+	uint word_from = 0;
 
 	for (uint i = 0; i < rf_counter; i++)
 	{
-	    if (i + 1 >= topbuffer_size)
-	    {
-	        topbuffer_size *= 2;
-	        char* tmp = realloc(top, topbuffer_size);
-	        top = tmp;
-	    }
-	    top[i] = root_file[i];
+		if (string)
+			i = find_any(rf, i, rf_counter, "\"", 1);
+		else if (comment)
+			i = find_any(rf, i, rf_counter, "\n", 1);
+		else
+			i = find_any(rf, i, rf_counter, "\"~I", 3);
+
+		if (i >= rf_counter)
+			break;
+
+		if (string || comment)
+		{
+			string = 0;
+			comment = 0;
+			continue;
+		}
+
+		if (rf[i] != 'I')
+		{
+			string = rf[i] == '"';
+			comment = rf[i] == '~';
+			continue;
+		}
+
+		if (!include_at(rf, rf_counter, i, word_from))
+			continue;
+
+		uint end = 0;
+		char* path = include_handler(rf, rf_counter, i + 6, &end);
+
+		if (path != NULL)
+		{
+			prefetch_add(path);
+			i = end + 1;
+			word_from = i + 1;
+		}
+	}
+}
+
+void* prefetch_worker(void* arg)
+{
+	(void)arg;
+
+	for (;;)
+	{
+		uint job = __atomic_fetch_add(&prefetch_next, 1, __ATOMIC_RELAXED);
+
+		if (job >= prefetch_end)
+			break;
+
+		pp_prefetch* pf = &prefetch_jobs[job];
+		pf->canonical = realpath(pf->path, NULL);
+
+		if (pf->canonical == NULL || stat(pf->canonical, &pf->st) != 0)
+		{
+			free(pf->canonical);
+			pf->canonical = NULL;
+			continue;
+		}
+
+		pf->loaded.path = pf->canonical;
+		include_read(&pf->loaded);
+	}
+
+	return NULL;
+}
+
+void prefetch_includes(const char* source, uint size, uint jobs)
+{
+	if (jobs < 2)
+		return;
+
+	prefetch_scan(source, size);
+	pthread_t* pool = malloc(sizeof(pthread_t) * jobs);
+
+	for (uint level = 0; level < prefetch_counter;)
+	{
+		prefetch_next = level;
+		prefetch_end = prefetch_counter;
+
+		uint threads = prefetch_end - level < jobs ? prefetch_end - level : jobs;
+		uint started = 1;
+
+		// The main thread is one of the workers
+		for (; started < threads; started++)
+		{
+			if (pthread_create(&pool[started], NULL, prefetch_worker, NULL) != 0)
+				break;
+		}
+
+		prefetch_worker(NULL);
+
+		for (uint t = 1; t < started; t++)
+			pthread_join(pool[t], NULL);
+
+		for (uint i = level; i < prefetch_end; i++)
+		{
+			pp_prefetch* pf = &prefetch_jobs[i];
+			bool fresh = 0;
+
+			if (pf->canonical == NULL || pf->loaded.buffer == NULL)
+			{
+				free(pf->canonical);
+				continue;
+			}
+
+			pp_include* inc = include_entry(pf->canonical, &pf->st, &fresh);
+
+			if (fresh)
+			{
+				inc->buffer = pf->loaded.buffer;
+				inc->size = pf->loaded.size;
+				inc->hash = pf->loaded.hash;
+				inc->valid = pf->loaded.valid;
+			}
+			else
+				unmap_buffer(pf->loaded.buffer, pf->loaded.size);
+
+			// Files without '@' stop the expansion anyway
+			if (inc->valid)
+				prefetch_scan(inc->buffer, inc->size);
+		}
+
+		level = prefetch_end;
+	}
+
+	free(pool);
+}
+
+/*
+	String and comment state of the scan. It is shared by
+	nested expands, so an included file that ends inside a
+	string or comment leaves the including file in it.
+*/
+
+bool delimiter_key = 0;
+bool commentline_key = 0;
+
+void expand(const char* rf, uint rf_counter, uint file, uint64_t hash)
+{
+	/*
+		Jumps from one byte that can change the scan to the
+		next: quotes, '~', the 'I' of INCLUDE, the newline
+		that ends a comment and '@' in the root file. Spans
+		in between are emitted later without being copied.
+	*/
+
+	const char* normal = file == 0 ? "\"~I@" : "\"~I";
+	const char* string = file == 0 ? "\"@" : "\"";
+	const char* comment = file == 0 ? "\n@" : "\n";
+	uint extra = file == 0;
+
+	// Start of the span not emitted yet
+	uint from = 0;
+	uint line = 1;
+	uint word_from = 0;
+	map_enter(file, line);
+
+	for (uint i = 0; i < rf_counter && !pp_stop; i++)
+	{
+		if (delimiter_key)
+			i = find_any(rf, i, rf_counter, string, 1 + extra);
+		else if (commentline_key)
+			i = find_any(rf, i, rf_counter, comment, 1 + extra);
+		else
+			i = find_any(rf, i, rf_counter, normal, 3 + extra);
+
+		if (i >= rf_counter)
+			break;
+
+		// '@' only ends included files
+		if (rf[i] == '@')
+		{
+			uint start = i;
+
+			while (start > 0 && rf[start - 1] != '\n')
+				start--;
 
-		pass_scan(root_file[i], prep_buffer);
-		if (delimiter_key == 1 || commentline_key == 1)
+			prep_error(source_files[file], count_lines(rf, i) + 1, i - start + 1, END_SYMBOL_WRONG);
+		}
+
+		if (delimiter_key || commentline_key)
+		{
+			delimiter_key = 0;
+			commentline_key = 0;
+			continue;
+		}
+
+		if (rf[i] != 'I')
+		{
+			delimiter_key = rf[i] == '"';
+			commentline_key = rf[i] == '~';
+			continue;
+		}
+
+		if (!include_at(rf, rf_counter, i, word_from))
 			continue;
 
-	    if (root_file[i] == ' ' || root_file[i] == '\n')
-	    {
-	        pb_size = 0;
-	        prep_buffer[0] = '\0';
-	        continue;
-	    }
+		i += 6;
+		uint end = 0;
+		char* literal = include_handler(rf, rf_counter, i, &end);
+		const char* path = literal == NULL ? NULL : include_resolve(literal);
+		pp_include* inc = NULL;
+		free(literal);
 
-	    if (pb_size + 1 >= 128)
-	        continue;
+		if (path == NULL || (inc = include_lookup(path)) == NULL)
+		{
+			pp_stop = 1;
+			break;
+		}
 
-	    prep_buffer[pb_size] = root_file[i];
-	    pb_size++;
-	    prep_buffer[pb_size] = '\0';
+		if (!inc->valid)
+			prep_error(path, 0, 0, END_SYMBOL);
 
-	    if (strcmp(prep_buffer, "INCLUDE") == 0)
-	    {
-	        char* result = include_handler(root_file, rf_counter, i);
+		if (include_once(inc))
+		{
+			word_from = i + 1;
+			continue;
+		}
 
-	        if (result == NULL)
-	        	return;
+		/*
+			Directive is kept and the char after the
+			closing quote is replaced by a newline
+		*/
 
-	        sync_top(result, &i);
-	        get_bottom(root_file, i, rf_counter);
-	        char* tmp_root = strdup(top);
-	        size_t new_size = strlen(tmp_root) + strlen(middle) + strlen(bottom) + 1;
-	        char* resized = realloc(tmp_root, new_size);
-	        tmp_root = resized;
-	        strcat(tmp_root, middle);
-	        strcat(tmp_root, bottom);
-	        root_file = tmp_root;
-	        rf_counter = strlen(root_file);
-	        clear_posstrg();
-	        pb_size = 0;
-	    }
+		inc->spliced = 1;
+
+		if (file == 0)
+			emit_piece(rf + from, end + 1 - from);
+		else
+			emit_span(rf, from, end + 1 - from, hash);
+
+		emit_piece("\n", 1);
+		line += count_lines(rf + from, end + 2 - from);
+		expand(inc->buffer, inc->size, add_source_file(path), inc->hash);
+
+		i = end + 1;
+		from = i + 1 < rf_counter ? i + 1 : rf_counter;
+		word_from = i + 1;
+		map_enter(file, line);
 	}
+
+	if (file == 0)
+		emit_piece(rf + from, rf_counter - from);
+	else
+		emit_span(rf, from, rf_counter - from, hash);
 }
 
+/*
+	Translation unit cache for --cache-dir. An entry holds the
+	expanded source, its source map and include spans and every
+	include file it was built from. Entries are keyed by the root path and
+	content; include files are checked by size and mtime first
+	and by content hash only when those changed. Every include
+	literal is resolved again on load, so a file that now shadows
+	one of them on the search path invalidates the entry. The least
+	recently used entries, of both caches, are evicted over
+	CACHE_LIMIT bytes.
+*/
+
+#define CACHE_MAGIC "SEALPP3"
+#define CACHE_LIMIT (64u << 20)
+
 typedef struct
 {
-	char* file_name;
-	uint line;
+	char magic[8];
+	uint deps;
+	uint resolves;
+	uint files;
+	uint map;
+	uint spans;
+	uint size;
 }
-dpfile_layer;
+cache_header;
 
-char* diagnostic_mark;
-void diagnostic_marker(char* rf_path)
+typedef struct
 {
-	uint dpb_size = 128;
-	uint dpb_counter = 0;
-	char* dp_buffer = malloc(dpb_size * sizeof(char));
+	uint64_t hash;
+	int64_t size;
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	uint path_length;
+}
+cache_dep;
 
-	uint layer_size = 128;
-	uint layer_point = 0;
-	dpfile_layer* layer = malloc(layer_size * sizeof(dpfile_layer));
+// Include literal and what it resolved to, 0 length when nothing
+typedef struct
+{
+	uint literal_length;
+	uint resolved_length;
+}
+cache_resolve;
 
-	layer[layer_point].file_name = rf_path;
-	layer[layer_point].line = 1;
-	diagnostic_mark = malloc(1);
-	diagnostic_mark[0] = '\0';
+typedef struct
+{
+	char* path;
+	off_t size;
+	struct timespec mtime;
+}
+cache_file;
+
+char* cache_entry(const char* converted, const char* source, uint size)
+{
+	char cwd[PATH_MAX];
+
+	if (getcwd(cwd, sizeof(cwd)) == NULL)
+		cwd[0] = '\0';
+
+	// Include paths are relative to the working directory
+	uint64_t key = fnv_hash(source, size);
+	key ^= fnv_hash(cwd, strlen(cwd)) * 31 + fnv_hash(converted, strlen(converted));
+
+	// Search paths change what an include resolves to
+	for (uint i = 0; i < arg_flagref.include_paths_counter; i++)
+		key = key * 31 + fnv_hash(arg_flagref.include_paths[i], strlen(arg_flagref.include_paths[i]));
+
+	mkdir(arg_flagref.cache_dir, 0755);
+
+	uint length = strlen(arg_flagref.cache_dir) + 32;
+	char* entry = malloc(length);
+	snprintf(entry, length, "%s/%016llx.sealpp", arg_flagref.cache_dir, (unsigned long long)key);
+	return entry;
+}
+
+bool cache_read(const char* *at, const char* end, void* out, uint size)
+{
+	if ((size_t)(end - *at) < size)
+		return 0;
+
+	memcpy(out, *at, size);
+	(*at) += size;
+	return 1;
+}
+
+bool cache_fresh(const cache_dep* dep, const char* path)
+{
+	struct stat st;
+
+	if (stat(path, &st) != 0)
+		return 0;
+
+	if (st.st_size == dep->size && st.st_mtim.tv_sec == dep->mtime_sec && st.st_mtim.tv_nsec == dep->mtime_nsec)
+		return 1;
+
+	// Touched but maybe not changed
+	uint size = 0;
+	char* buffer = map_buffer(path, &size);
+
+	if (buffer == NULL)
+		return 0;
+
+	bool same = size == dep->size && fnv_hash(buffer, size) == dep->hash;
+	unmap_buffer(buffer, size);
+	return same;
+}
+
+// Later stages index with the map and the spans, so they are checked once here
+bool cache_check(const cache_header* header, const source_map_entry* map, const include_span* spans)
+{
+	for (uint i = 0; i < header->map; i++)
+	{
+		if (map[i].file >= header->files || map[i].offset > header->size)
+			return 0;
+	}
 
-	for (uint i = 0; root_file[i] != '\0'; i++)
+	uint64_t from = 0;
+
+	for (uint i = 0; i < header->spans; i++)
+	{
+		if (spans[i].offset < from || (uint64_t)spans[i].offset + spans[i].length > header->size)
+			return 0;
+
+		from = (uint64_t)spans[i].offset + spans[i].length;
+	}
+
+	return 1;
+}
+
+bool cache_load(const char* entry)
+{
+	uint size = 0;
+	const char* buffer = map_buffer(entry, &size);
+	const char* at = buffer;
+	const char* end = buffer + size;
+	cache_header header;
+
+	if (buffer == NULL)
+		return 0;
+
+	if (!cache_read(&at, end, &header, sizeof(header)) ||
+		memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0)
 	{
-	    if (dpb_counter + 1 >= dpb_size)
-	    {
-	        dpb_size *= 2;
-	        char* tmp = realloc(dp_buffer, dpb_size);
-	        dp_buffer = tmp;
-	    }
+		unmap_buffer((char*)buffer, size);
+		return 0;
+	}
 
-	    if (layer_point + 1 >= layer_size)
-	    {
-	        layer_size *= 2;
-	        layer = realloc(layer, layer_size * sizeof(dpfile_layer));
-	    }
+	// Counts are from the file, each item takes at least this many bytes of it
+	uint64_t least = (uint64_t)header.deps * (sizeof(cache_dep) + 1) +
+		(uint64_t)header.resolves * (sizeof(cache_resolve) + 2) + (uint64_t)header.files * (sizeof(uint) + 1) +
+		(uint64_t)header.map * sizeof(source_map_entry) + (uint64_t)header.spans * sizeof(include_span) + header.size;
+
+	if (header.map == 0 || least > (uint64_t)(end - at))
+	{
+		unmap_buffer((char*)buffer, size);
+		return 0;
+	}
 
-		if (root_file[i] == '@')
+	const char** deps = malloc(sizeof(char*) * (header.deps + 1));
+
+	for (uint i = 0; i < header.deps; i++)
+	{
+		cache_dep dep;
+
+		if (!cache_read(&at, end, &dep, sizeof(dep)) || (size_t)(end - at) <= dep.path_length ||
+			!cache_fresh(&dep, at))
 		{
-			if (layer_point == 0)
-	 		{
-				printf("%d", layer[layer_point].line);
-				prep_error(rf_path, layer[layer_point].line, dpb_counter, END_SYMBOL_WRONG);
-			}
-			layer_point--;
+			free(deps);
+			unmap_buffer((char*)buffer, size);
+			return 0;
+		}
+
+		deps[i] = at;
+		at += dep.path_length + 1;
+	}
 
-			if (layer_point == 0)
-				layer[layer_point].line++;
+	for (uint i = 0; i < header.resolves; i++)
+	{
+		cache_resolve resolve;
+		bool same = cache_read(&at, end, &resolve, sizeof(resolve)) &&
+			(size_t)(end - at) > (size_t)resolve.literal_length + resolve.resolved_length + 1;
+
+		if (same)
+		{
+			const char* literal = at;
+			const char* resolved = include_resolve(literal);
+			at += resolve.literal_length + 1;
+
+			same = resolved == NULL ? resolve.resolved_length == 0 :
+				resolve.resolved_length != 0 && strcmp(resolved, at) == 0;
+			at += resolve.resolved_length + 1;
 		}
 
-		if (root_file[i] == '\n')
+		if (!same)
 		{
-			char* dm_tmpline = NULL;
+			free(deps);
+			unmap_buffer((char*)buffer, size);
+			return 0;
+		}
+	}
 
-			while (*layer[layer_point].file_name == ' ' || *layer[layer_point].file_name == '\n')
-				layer[layer_point].file_name++;
+	// Names are used in place, they end with '\0' in the entry
+	char** files = malloc(sizeof(char*) * (header.files + 1));
 
-			asprintf(&dm_tmpline, "%s:%d\n", layer[layer_point].file_name, layer[layer_point].line); 
-			diagnostic_mark = realloc(diagnostic_mark, strlen(diagnostic_mark) + strlen(dm_tmpline) + 1); 
-			strcat(diagnostic_mark, dm_tmpline);
+	for (uint i = 0; i < header.files; i++)
+	{
+		uint length = 0;
+
+		if (!cache_read(&at, end, &length, sizeof(length)) || (size_t)(end - at) <= length)
+		{
+			free(deps);
+			free(files);
+			unmap_buffer((char*)buffer, size);
+			return 0;
+		}
+
+		files[i] = (char*)at;
+		at += length + 1;
+	}
+
+	source_map_entry* map = malloc(sizeof(source_map_entry) * (header.map + 1));
+	include_span* spans = malloc(sizeof(include_span) * (header.spans + 1));
+
+	if (!cache_read(&at, end, map, sizeof(source_map_entry) * header.map) ||
+		!cache_read(&at, end, spans, sizeof(include_span) * header.spans) || (size_t)(end - at) != header.size ||
+		!cache_check(&header, map, spans))
+	{
+		free(deps);
+		free(files);
+		free(map);
+		free(spans);
+		unmap_buffer((char*)buffer, size);
+		return 0;
+	}
+
+	dependencies = deps;
+	dependencies_counter = header.deps;
+	source_files = files;
+	source_files_counter = header.files;
+	source_map = map;
+	source_map_counter = header.map;
+	source_map_size = header.map + 1;
+	include_spans = spans;
+	include_spans_counter = header.spans;
+	include_spans_size = header.spans + 1;
+
+	// Last part of the entry, the mapping keeps the '\0' after it
+	root_file = (char*)at;
+	rf_counter = header.size;
+
+	// Recently used
+	utimensat(AT_FDCWD, entry, NULL, 0);
+	return 1;
+}
+
+int cache_compare(const void* a, const void* b)
+{
+	const cache_file* left = a;
+	const cache_file* right = b;
+
+	if (left->mtime.tv_sec != right->mtime.tv_sec)
+		return left->mtime.tv_sec < right->mtime.tv_sec ? -1 : 1;
+
+	return (left->mtime.tv_nsec > right->mtime.tv_nsec) - (left->mtime.tv_nsec < right->mtime.tv_nsec);
+}
+
+void cache_evict()
+{
+	DIR* dir = opendir(arg_flagref.cache_dir);
+
+	if (dir == NULL)
+		return;
+
+	cache_file* files = NULL;
+	uint files_counter = 0;
+	uint64_t total = 0;
+	struct dirent* ent;
+
+	while ((ent = readdir(dir)) != NULL)
+	{
+		uint length = strlen(ent->d_name);
+
+		if (length < 7 || (strcmp(ent->d_name + length - 7, ".sealpp") != 0 &&
+			strcmp(ent->d_name + length - 7, ".sealtk") != 0))
+			continue;
+
+		uint path_length = strlen(arg_flagref.cache_dir) + length + 2;
+		char* path = malloc(path_length);
+		snprintf(path, path_length, "%s/%s", arg_flagref.cache_dir, ent->d_name);
 
-			layer[layer_point].line++;
+		struct stat st;
+
+		if (stat(path, &st) != 0)
+		{
+			free(path);
+			continue;
 		}
 
-		pass_scan(root_file[i], dp_buffer);
-		if (delimiter_key == 1 || commentline_key == 1)
+		files = realloc(files, sizeof(cache_file) * (files_counter + 1));
+		files[files_counter].path = path;
+		files[files_counter].size = st.st_size;
+		files[files_counter].mtime = st.st_mtim;
+		files_counter++;
+		total += st.st_size;
+	}
+
+	closedir(dir);
+
+	if (total > CACHE_LIMIT)
+		qsort(files, files_counter, sizeof(cache_file), cache_compare);
+
+	for (uint i = 0; i < files_counter; i++)
+	{
+		if (total > CACHE_LIMIT && unlink(files[i].path) == 0)
+			total -= files[i].size;
+
+		free(files[i].path);
+	}
+
+	free(files);
+}
+
+void cache_store(const char* entry)
+{
+	uint length = strlen(entry) + 16;
+	char* temp = malloc(length);
+	snprintf(temp, length, "%s.%d", entry, (int)getpid());
+
+	// The cache is best effort, a failed write is not an error
+	FILE* out = fopen(temp, "wb");
+
+	if (out == NULL)
+	{
+		free(temp);
+		return;
+	}
+
+	cache_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+	header.files = source_files_counter;
+	header.map = source_map_counter;
+	header.spans = include_spans_counter;
+	header.size = rf_counter;
+
+	for (uint i = 0; i < includes_counter; i++)
+		header.deps += includes[i].buffer != NULL;
+
+	header.resolves = resolved_includes.counter;
+
+	fwrite(&header, sizeof(header), 1, out);
+
+	for (uint i = 0; i < includes_counter; i++)
+	{
+		if (includes[i].buffer == NULL)
 			continue;
 
-	    if (root_file[i] == ' ' || root_file[i] == '\n')
-	    {
-	        dpb_counter = 0;
-	        dp_buffer[0] = '\0';
-	        continue;
-	    }
-
-	    dp_buffer[dpb_counter] = root_file[i];
-	    dpb_counter++;
-	    dp_buffer[dpb_counter] = '\0';
-
-	    if (strcmp(dp_buffer, "INCLUDE") == 0)
-	    {
-	    	char* result = include_handler(root_file, rf_counter, i);
-			if (result == NULL)
-				return;
-
-	    	layer_point++;
-	    	layer[layer_point].file_name = result;
-	    	layer[layer_point].line = 1;
+		cache_dep dep;
+		memset(&dep, 0, sizeof(dep));
+		dep.hash = includes[i].hash;
+		dep.size = includes[i].size;
+		dep.mtime_sec = includes[i].mtime.tv_sec;
+		dep.mtime_nsec = includes[i].mtime.tv_nsec;
+		dep.path_length = strlen(includes[i].path);
+
+		fwrite(&dep, sizeof(dep), 1, out);
+		fwrite(includes[i].path, 1, dep.path_length + 1, out);
+	}
+
+	for (uint i = 0; i < resolved_includes.counter; i++)
+	{
+		const char* resolved = resolved_includes.values[i];
+
+		cache_resolve resolve;
+		resolve.literal_length = strlen(resolved_includes.keys[i]);
+		resolve.resolved_length = resolved == NULL ? 0 : strlen(resolved);
+
+		fwrite(&resolve, sizeof(resolve), 1, out);
+		fwrite(resolved_includes.keys[i], 1, resolve.literal_length + 1, out);
+		fwrite(resolved == NULL ? "" : resolved, 1, resolve.resolved_length + 1, out);
+	}
+
+	for (uint i = 0; i < source_files_counter; i++)
+	{
+		uint name_length = strlen(source_files[i]);
+		fwrite(&name_length, sizeof(name_length), 1, out);
+		fwrite(source_files[i], 1, name_length + 1, out);
+	}
+
+	fwrite(source_map, sizeof(source_map_entry), source_map_counter, out);
+	fwrite(include_spans, sizeof(include_span), include_spans_counter, out);
+	fwrite(root_file, 1, rf_counter, out);
+
+	if (fclose(out) != 0 || rename(temp, entry) != 0)
+		unlink(temp);
+
+	free(temp);
+	cache_evict();
+}
+
+void analyzer(char* converted)
+{
+	uint size = 0;
+	char* source = map_buffer(converted, &size);
+
+	if (source == NULL)
+		prep_error(converted, 0, 0, FILE_NOT_EXISTS);
+
+	char* entry = NULL;
+
+	if (arg_flagref.cache_dir != NULL)
+	{
+		entry = cache_entry(converted, source, size);
+
+		if (cache_load(entry))
+		{
+			// The source was only needed for the key
+			unmap_buffer(source, size);
+			free(entry);
+			return;
 		}
 	}
+
+	prefetch_includes(source, size, arg_flagref.jobs);
+	expand(source, size, add_source_file(converted), 0);
+
+	// Without includes the mapped file is lexed in place
+	if (pieces_counter == 1 && pieces[0].data == source && pieces[0].length == size)
+	{
+		root_file = source;
+		rf_counter = size;
+	}
+	else
+		root_file = materialize_pieces(&rf_counter);
+
+	dependencies = malloc(sizeof(char*) * (includes_counter + 1));
+
+	for (uint i = 0; i < includes_counter; i++)
+	{
+		if (includes[i].buffer != NULL)
+			dependencies[dependencies_counter++] = includes[i].path;
+	}
+
+	if (entry != NULL && !pp_stop)
+		cache_store(entry);
+
+	free(entry);
 }
 
 void pp_main(char* *converted)
 {
 	analyzer(*converted);
-	diagnostic_marker(*converted);
+}
+
+void depfile_escape(FILE* out, const char* path)
+{
+	// Make syntax, spaces and '#' are escaped and '$' is doubled
+	for (; *path != '\0'; path++)
+	{
+		if (*path == ' ' || *path == '#')
+			fputc('\\', out);
+		else if (*path == '$')
+			fputc('$', out);
+
+		fputc(*path, out);
+	}
+}
+
+void pp_depfile(const char* source, const char* output)
+{
+	/*
+		Writes "<output>.d" with a single rule, the binary
+		depends on the root file and every include file
+	*/
+
+	#ifdef _WIN32
+		const char* target = output == NULL ? "a.exe" : output;
+	#else
+		const char* target = output == NULL ? "a" : output;
+	#endif
+
+	uint length = strlen(output == NULL ? "a" : output) + 3;
+	char* name = malloc(length);
+	snprintf(name, length, "%s.d", output == NULL ? "a" : output);
+
+	FILE* out = fopen(name, "w");
+
+	if (out == NULL)
+		prep_error(name, 0, 0, DEPFILE_CANNOT_WRITE);
+
+	depfile_escape(out, target);
+	fputc(':', out);
+
+	if (strcmp(source, "-") != 0)
+	{
+		fputc(' ', out);
+		depfile_escape(out, source);
+	}
+
+	for (uint i = 0; i < dependencies_counter; i++)
+	{
+		fputs(" \\\n ", out);
+		depfile_escape(out, dependencies[i]);
+	}
+
+	fputc('\n', out);
+	fclose(out);
+	free(name);
 }
@@ -3,10 +3,37 @@
 
 #include "../common.h"
 
+typedef struct
+{
+	uint offset;    // offset in the expanded source
+	uint exp_line;  // line in the expanded source
+	uint file;      // index of source_files
+	uint line;      // line in the original file
+}
+source_map_entry;
+
+typedef struct
+{
+	uint offset;  // offset in the expanded source
+	uint length;
+	uint64_t key; // content hash of the file and where the span is in it
+}
+include_span;
+
 void pp_main(char* *converted);
+void pp_depfile(const char* source, const char* output);
+const char* source_location(uint exp_line, uint *line);
+const char* include_resolve(const char* path);
+void cache_evict();
 
 extern char* root_file;
 extern uint rf_counter;
-extern char* diagnostic_mark;
+
+extern char** source_files;
+extern source_map_entry* source_map;
+extern uint source_map_counter;
+
+extern include_span* include_spans;
+extern uint include_spans_counter;
 
 #endif
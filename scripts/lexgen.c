@@ -0,0 +1,563 @@
+/*
+
+	Seal Compiler - Lexer table generator
+	Copyright (C) 2026 Habil Yıldırım
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+	Compiles the token grammar into the transition table of the
+	lexer, written out as lexer_dfa.h. make.lua runs it before
+	every build.
+
+		lexgen lexer_dfa.h
+
+	A step looks at the current char and the one after it, both
+	folded into classes, and gives the next state and an action.
+	The lexer runs the actions, the grammar only lives here. It
+	follows the old buffer_mod machine byte for byte, so both
+	lexers give the same tokens.
+*/
+
+typedef enum
+{
+	C_NUL,
+	C_SPACE,
+	C_NEWLINE,
+	C_AT,
+	C_SLASH,
+	C_TILDE,
+	C_DQUOTE,
+	C_SQUOTE,
+	C_BACKSLASH,
+	C_ZERO,
+	C_ONE,
+	C_DIGIT,      // 2-9
+	C_DOT,
+	C_X,
+	C_B,
+	C_HEX_ESCAPE, // a f, hexadecimal and escape
+	C_HEX,        // c d e A-F
+	C_ESCAPE,     // n r t v
+	C_ALPHA,
+	C_UNDERSCORE,
+	C_BANG,
+	C_LESS,
+	C_GREATER,
+	C_EQUAL,
+	C_AMP,
+	C_PIPE,
+	C_SYMBOL,
+	C_OTHER,
+	CLASSES,
+}
+_class;
+
+const char* class_names[CLASSES] =
+{
+	"NUL", "SPACE", "NEWLINE", "AT", "SLASH", "TILDE", "DQUOTE", "SQUOTE",
+	"BACKSLASH", "ZERO", "ONE", "DIGIT", "DOT", "X", "B", "HEX_ESCAPE", "HEX",
+	"ESCAPE", "ALPHA", "UNDERSCORE", "BANG", "LESS", "GREATER", "EQUAL", "AMP",
+	"PIPE", "SYMBOL", "OTHER",
+};
+
+// The next char only matters for these
+typedef enum
+{
+	L_OTHER,
+	L_SPACE, // also '\0'
+	L_TILDE,
+	L_SLASH,
+	L_X,
+	L_B,
+	L_EQUAL,
+	L_AMP,
+	L_PIPE,
+	LOOKAHEADS,
+}
+_lookahead;
+
+typedef enum
+{
+	S_READ,         // nothing in the lexeme buffer
+	S_WORD,
+	S_QUOTE,        // after a ', which is dropped
+	S_STRING_OPEN,  // after a ", comments still start here
+	S_STRING,
+	S_ESCAPE,
+	S_LINE_COMMENT,
+	S_BLOCK_COMMENT,
+	S_AFTER,        // the char after a literal, only scanned for a token
+	S_HEX_PREFIX,
+	S_HEX,
+	S_BIN_PREFIX,
+	S_BIN,
+	S_DOT,          // a lone '.' so far
+	S_DECIMAL,
+	S_DECIMAL_DOT,
+	STATES,
+}
+_state;
+
+const char* state_names[STATES] =
+{
+	"READ", "WORD", "QUOTE", "STRING_OPEN", "STRING", "ESCAPE", "LINE_COMMENT",
+	"BLOCK_COMMENT", "AFTER", "HEX_PREFIX", "HEX", "BIN_PREFIX", "BIN", "DOT",
+	"DECIMAL", "DECIMAL_DOT",
+};
+
+typedef enum
+{
+	A_SKIP,
+	A_APPEND,
+	A_ESCAPE,           // appends the escaped char
+	A_STRING,
+	A_SPACE,            // ends a word
+	A_SYMBOL,
+	A_OPERATOR,
+	A_OPERATOR_SPACE,   // a single char operator takes the space after it
+	A_OPERATOR2,
+	A_RADIX,            // end of a hexadecimal or binary literal
+	A_HOLD,             // end of a decimal, the char is read again
+	A_INVALID_CHAR,
+	A_INVALID_ESCAPE,
+	A_IS_NOT_HEX,
+	A_IS_NOT_BIN,
+	A_IS_NOT_DECIMAL,
+	A_MULTIPLE_DOTS,
+	ACTIONS,
+}
+_action;
+
+const char* action_names[ACTIONS] =
+{
+	"SKIP", "APPEND", "ESCAPE", "STRING", "SPACE", "SYMBOL", "OPERATOR",
+	"OPERATOR_SPACE", "OPERATOR2", "RADIX", "HOLD", "INVALID_CHAR",
+	"INVALID_ESCAPE", "IS_NOT_HEX", "IS_NOT_BIN", "IS_NOT_DECIMAL",
+	"MULTIPLE_DOTS",
+};
+
+// Runs the lexer takes a block at a time, see dfa_run
+typedef enum
+{
+	R_NONE,
+	R_SPACE,
+	R_WORD,
+	R_STRING,
+	R_LINE,
+	R_BLOCK,
+	RUNS,
+}
+_run;
+
+const char* run_names[RUNS] = {"NONE", "SPACE", "WORD", "STRING", "LINE", "BLOCK"};
+
+const _run state_runs[STATES] =
+{
+	[S_READ] = R_SPACE,
+	[S_WORD] = R_WORD,
+	[S_STRING] = R_STRING,
+	[S_LINE_COMMENT] = R_LINE,
+	[S_BLOCK_COMMENT] = R_BLOCK,
+};
+
+/*
+	States that still read the '\0' after the buffer. The old
+	lexer ended literals inside its byte loop and looked at the
+	char after them even at the end.
+*/
+
+const bool state_tails[STATES] =
+{
+	[S_ESCAPE] = 1, [S_AFTER] = 1, [S_HEX_PREFIX] = 1, [S_HEX] = 1,
+	[S_BIN_PREFIX] = 1, [S_BIN] = 1, [S_DOT] = 1, [S_DECIMAL] = 1,
+	[S_DECIMAL_DOT] = 1,
+};
+
+typedef struct
+{
+	uint8_t next;
+	uint8_t action;
+}
+_entry;
+
+_class class_of(int c)
+{
+	switch (c)
+	{
+		case '\0': return C_NUL;
+		case ' ': case '\t': case '\v': case '\f': case '\r': return C_SPACE;
+		case '\n': return C_NEWLINE;
+		case '@': return C_AT;
+		case '/': return C_SLASH;
+		case '~': return C_TILDE;
+		case '"': return C_DQUOTE;
+		case '\'': return C_SQUOTE;
+		case '\\': return C_BACKSLASH;
+		case '0': return C_ZERO;
+		case '1': return C_ONE;
+		case '.': return C_DOT;
+		case 'x': return C_X;
+		case 'b': return C_B;
+		case 'a': case 'f': return C_HEX_ESCAPE;
+		case 'n': case 'r': case 't': case 'v': return C_ESCAPE;
+		case '_': return C_UNDERSCORE;
+		case '!': return C_BANG;
+		case '<': return C_LESS;
+		case '>': return C_GREATER;
+		case '=': return C_EQUAL;
+		case '&': return C_AMP;
+		case '|': return C_PIPE;
+	}
+
+	if (c >= '2' && c <= '9')
+		return C_DIGIT;
+	if ((c >= 'c' && c <= 'e') || (c >= 'A' && c <= 'F'))
+		return C_HEX;
+	if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+		return C_ALPHA;
+	if (c != 0 && strchr(";,(){}[]+-*%#:$", c) != NULL)
+		return C_SYMBOL;
+
+	return C_OTHER;
+}
+
+_lookahead lookahead_of(int c)
+{
+	switch (c)
+	{
+		case '\0': case ' ': case '\t': case '\n': case '\v': case '\f': case '\r':
+			return L_SPACE;
+		case '~': return L_TILDE;
+		case '/': return L_SLASH;
+		case 'x': return L_X;
+		case 'b': return L_B;
+		case '=': return L_EQUAL;
+		case '&': return L_AMP;
+		case '|': return L_PIPE;
+	}
+
+	return L_OTHER;
+}
+
+char escape_of(int c)
+{
+	switch (c)
+	{
+		case '\\': return '\\';
+		case '\'': return '\'';
+		case '"': return '"';
+		case 'n': return '\n';
+		case 'r': return '\r';
+		case 't': return '\t';
+		case 'v': return '\v';
+		case 'b': return '\b';
+		case 'f': return '\f';
+		case 'a': return '\a';
+		case '0': return '\0';
+	}
+
+	return 1; // not an escape
+}
+
+bool is_escape(_class c)
+{
+	return c == C_BACKSLASH || c == C_SQUOTE || c == C_DQUOTE || c == C_ESCAPE ||
+		c == C_B || c == C_HEX_ESCAPE || c == C_ZERO;
+}
+
+bool is_alpha(_class c)
+{
+	return c == C_X || c == C_B || c == C_HEX_ESCAPE || c == C_HEX || c == C_ESCAPE || c == C_ALPHA;
+}
+
+bool is_digit(_class c)
+{
+	return c == C_ZERO || c == C_ONE || c == C_DIGIT;
+}
+
+bool is_word(_class c)
+{
+	return is_alpha(c) || is_digit(c) || c == C_UNDERSCORE;
+}
+
+_entry entry(_state next, _action action)
+{
+	return (_entry){next, action};
+}
+
+// A char that ends a word or a literal: word char, space, operator or symbol
+_entry token(_class c, _lookahead n)
+{
+	if (is_word(c))
+		return entry(S_WORD, A_APPEND);
+
+	switch (c)
+	{
+		case C_SPACE:
+		case C_NEWLINE:
+			return entry(S_READ, A_SPACE);
+
+		case C_BANG:
+		case C_LESS:
+		case C_GREATER:
+			if (n == L_EQUAL)
+				return entry(S_READ, A_OPERATOR2);
+
+			return entry(S_READ, n == L_SPACE ? A_OPERATOR_SPACE : A_OPERATOR);
+
+		case C_EQUAL:
+			return entry(S_READ, n == L_EQUAL ? A_OPERATOR2 : A_SYMBOL);
+		case C_AMP:
+			return entry(S_READ, n == L_AMP ? A_OPERATOR2 : A_INVALID_CHAR);
+		case C_PIPE:
+			return entry(S_READ, n == L_PIPE ? A_OPERATOR2 : A_INVALID_CHAR);
+
+		case C_AT:
+		case C_SLASH:
+		case C_DQUOTE:
+		case C_SQUOTE:
+		case C_BACKSLASH:
+		case C_SYMBOL:
+			return entry(S_READ, A_SYMBOL);
+
+		default:
+			return entry(S_READ, A_INVALID_CHAR);
+	}
+}
+
+_entry string(_class c)
+{
+	if (c == C_DQUOTE)
+		return entry(S_AFTER, A_STRING);
+	if (c == C_BACKSLASH)
+		return entry(S_ESCAPE, A_SKIP);
+
+	return entry(S_STRING, A_APPEND);
+}
+
+_entry step(_state s, _class c, _lookahead n)
+{
+	/* ==== LITERALS, no comments inside ==== */
+
+	switch (s)
+	{
+		case S_STRING:
+			return string(c);
+
+		case S_ESCAPE:
+			return is_escape(c) ? entry(S_STRING, A_ESCAPE) : entry(S_ESCAPE, A_INVALID_ESCAPE);
+
+		case S_AFTER:
+			return token(c, n);
+
+		case S_HEX_PREFIX:
+		case S_HEX:
+			if (is_digit(c) || c == C_B || c == C_HEX_ESCAPE || c == C_HEX || (s == S_HEX_PREFIX && c == C_X))
+				return entry(S_HEX, A_APPEND);
+
+			return is_alpha(c) ? entry(s, A_IS_NOT_HEX) : entry(S_AFTER, A_RADIX);
+
+		case S_BIN_PREFIX:
+		case S_BIN:
+			if (c == C_ZERO || c == C_ONE || (s == S_BIN_PREFIX && c == C_B))
+				return entry(S_BIN, A_APPEND);
+
+			return is_alpha(c) || c == C_DIGIT ? entry(s, A_IS_NOT_BIN) : entry(S_AFTER, A_RADIX);
+
+		case S_DOT:
+		case S_DECIMAL:
+		case S_DECIMAL_DOT:
+			if (is_digit(c))
+				return entry(S_DECIMAL, A_APPEND);
+			if (c == C_DOT)
+				return s == S_DECIMAL ? entry(S_DECIMAL_DOT, A_APPEND) : entry(s, A_MULTIPLE_DOTS);
+
+			// The number is left in the lexeme buffer and ends as a word
+			if (is_alpha(c) || s == S_DOT)
+				return entry(s, A_IS_NOT_DECIMAL);
+
+			return entry(S_AFTER, A_HOLD);
+
+		default:
+			break;
+	}
+
+	/* ==== COMMENTS ==== */
+
+	if (c == C_AT)
+		return entry(s, A_SKIP);
+
+	if (c == C_SLASH && n == L_TILDE)
+		return entry(S_BLOCK_COMMENT, A_SKIP);
+
+	// "~/" ends a block comment and the '~' starts a line one
+	if (s == S_BLOCK_COMMENT)
+		return entry(c == C_TILDE && n == L_SLASH ? S_LINE_COMMENT : S_BLOCK_COMMENT, A_SKIP);
+
+	if (c == C_TILDE)
+		return entry(S_LINE_COMMENT, A_SKIP);
+
+	if (s == S_LINE_COMMENT)
+		return c == C_NEWLINE ? token(c, n) : entry(S_LINE_COMMENT, A_SKIP);
+
+	/* ==== TOKENS ==== */
+
+	if (s == S_STRING_OPEN)
+		return string(c);
+
+	if (s == S_QUOTE)
+		return token(c, n);
+
+	if (s == S_READ && c == C_ZERO && n == L_X)
+		return entry(S_HEX_PREFIX, A_APPEND);
+	if (s == S_READ && c == C_ZERO && n == L_B)
+		return entry(S_BIN_PREFIX, A_APPEND);
+	if (s == S_READ && is_digit(c))
+		return entry(S_DECIMAL, A_APPEND);
+	if (s == S_READ && c == C_DOT)
+		return entry(S_DOT, A_APPEND);
+
+	if (c == C_DQUOTE)
+		return entry(S_STRING_OPEN, A_SKIP);
+	if (c == C_SQUOTE)
+		return entry(S_QUOTE, A_SKIP);
+
+	return token(c, n);
+}
+
+bool run_takes(_run run, _class c)
+{
+	switch (run)
+	{
+		case R_SPACE: return c == C_SPACE || c == C_NEWLINE;
+		case R_WORD: return is_word(c);
+		case R_STRING: return c != C_DQUOTE && c != C_BACKSLASH;
+		case R_LINE: return c != C_SLASH && c != C_NEWLINE;
+		case R_BLOCK: return c != C_TILDE;
+		default: return 0;
+	}
+}
+
+_entry table[STATES][CLASSES][LOOKAHEADS];
+
+int main(int argc, char** argv)
+{
+	if (argc != 2)
+	{
+		fprintf(stderr, "Usage: lexgen output.h\n");
+		return 1;
+	}
+
+	for (uint s = 0; s < STATES; s++)
+		for (uint c = 0; c < CLASSES; c++)
+			for (uint n = 0; n < LOOKAHEADS; n++)
+				table[s][c][n] = step(s, c, n);
+
+	// A run must be chars that keep the state and take no token
+	for (uint s = 0; s < STATES; s++)
+		for (uint c = 0; c < CLASSES; c++)
+			for (uint n = 0; run_takes(state_runs[s], c) && n < LOOKAHEADS; n++)
+			{
+				_entry e = table[s][c][n];
+
+				if (e.next != s || (e.action != A_SKIP && e.action != A_APPEND && e.action != A_SPACE))
+				{
+					fprintf(stderr, "lexgen: run of %s breaks on %s\n", state_names[s], class_names[c]);
+					return 1;
+				}
+			}
+
+	FILE* out = fopen(argv[1], "w");
+
+	if (out == NULL)
+	{
+		fprintf(stderr, "lexgen: %s cannot be written\n", argv[1]);
+		return 1;
+	}
+
+	fprintf(out, "// Generated by scripts/lexgen.c, do not edit\n\n");
+	fprintf(out, "#ifndef LEXER_DFA_H\n#define LEXER_DFA_H\n\n");
+
+	fprintf(out, "enum\n{\n");
+	for (uint s = 0; s < STATES; s++)
+		fprintf(out, "\tDFA_%s,\n", state_names[s]);
+	fprintf(out, "\tDFA_STATES,\n};\n\n");
+
+	fprintf(out, "enum\n{\n");
+	for (uint a = 0; a < ACTIONS; a++)
+		fprintf(out, "\tDO_%s,\n", action_names[a]);
+	fprintf(out, "};\n\n");
+
+	fprintf(out, "enum\n{\n");
+	for (uint r = 0; r < RUNS; r++)
+		fprintf(out, "\tRUN_%s,\n", run_names[r]);
+	fprintf(out, "};\n\n");
+
+	fprintf(out, "#define DFA_CLASSES %d\n#define DFA_LOOKAHEADS %d\n\n", CLASSES, LOOKAHEADS);
+	fprintf(out, "typedef struct\n{\n\tuint8_t next;\n\tuint8_t action;\n}\n_dfa_entry;\n\n");
+
+	fprintf(out, "static const uint8_t dfa_classes[256] =\n{");
+	for (uint c = 0; c < 256; c++)
+		fprintf(out, "%s%2d,", c % 16 == 0 ? "\n\t" : " ", class_of(c));
+	fprintf(out, "\n};\n\n");
+
+	fprintf(out, "static const uint8_t dfa_lookaheads[256] =\n{");
+	for (uint c = 0; c < 256; c++)
+		fprintf(out, "%s%d,", c % 16 == 0 ? "\n\t" : " ", lookahead_of(c));
+	fprintf(out, "\n};\n\n");
+
+	fprintf(out, "static const char dfa_escapes[256] =\n{");
+	for (uint c = 0; c < 256; c++)
+		fprintf(out, "%s%2d,", c % 16 == 0 ? "\n\t" : " ", escape_of(c));
+	fprintf(out, "\n};\n\n");
+
+	fprintf(out, "static const uint8_t dfa_runs[DFA_STATES] =\n{\n");
+	for (uint s = 0; s < STATES; s++)
+		fprintf(out, "\tRUN_%s, // %s\n", run_names[state_runs[s]], state_names[s]);
+	fprintf(out, "};\n\n");
+
+	fprintf(out, "static const bool dfa_tails[DFA_STATES] =\n{\n");
+	for (uint s = 0; s < STATES; s++)
+		fprintf(out, "\t%d, // %s\n", state_tails[s], state_names[s]);
+	fprintf(out, "};\n\n");
+
+	fprintf(out, "static const _dfa_entry dfa_table[DFA_STATES][DFA_CLASSES][DFA_LOOKAHEADS] =\n{\n");
+	for (uint s = 0; s < STATES; s++)
+	{
+		fprintf(out, "\t{ // %s\n", state_names[s]);
+
+		for (uint c = 0; c < CLASSES; c++)
+		{
+			fprintf(out, "\t\t{");
+			for (uint n = 0; n < LOOKAHEADS; n++)
+				fprintf(out, "{%2d,%2d}%s", table[s][c][n].next, table[s][c][n].action, n + 1 < LOOKAHEADS ? "," : "");
+			fprintf(out, "}, // %s\n", class_names[c]);
+		}
+
+		fprintf(out, "\t},\n");
+	}
+	fprintf(out, "};\n\n#endif\n");
+
+	fclose(out);
+	return 0;
+}
@@ -0,0 +1,247 @@
+/*
+
+	Seal Compiler - Word classifier benchmark
+	Copyright (C) 2026 Habil Yıldırım
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "../lexer.h"
+#include <time.h>
+
+/*
+	Times query_word, the perfect hash of lexer.c, against the
+	linear strcmp walk over the data type and keyword tables it
+	replaced. Both must classify every word the same way.
+
+		gcc -O2 -pthread scripts/wordbench.c common.c preprocessor/preprocessor.c \
+			diagnostic.c lexer.c macro.c parser.c semantic.c ir.c codegen.c -o bin/wordbench
+		bin/wordbench [file.seal] [rounds]
+
+	Without a file the words are a generated mix of identifiers,
+	integers, data types and keywords.
+*/
+
+arg_flags arg_flagref;
+
+_token_type query_word(const char *lexeme, uint length, _token_group *group);
+
+typedef struct
+{
+	const char *lexeme;
+	_token_type token_type;
+}
+_linear_word;
+
+const _linear_word data_type_table[] =
+{
+	{"i1",        DTYPE_BINARY},
+	{"integer",   DTYPE_INTEGER},
+	{"i8",        DTYPE_INTEGER8},
+	{"i16",       DTYPE_INTEGER16},
+	{"i32",       DTYPE_INTEGER32},
+	{"i64",       DTYPE_INTEGER64},
+	{"float",     DTYPE_FLOAT},
+	{"double",    DTYPE_DOUBLE},
+	{"char",      DTYPE_CHAR},
+};
+#define DATA_TYPE_TABLE_LENGTH 9
+
+const _linear_word keyword_table[] =
+{
+	{"INCLUDE",  KEYWORD_INCLUDE},
+	{"DEFINE",   KEYWORD_MACRO},
+	{"return",   KEYWORD_RETURN},
+	{"jump",     KEYWORD_JUMPER},
+};
+#define KEYWORD_TABLE_LENGTH 4
+
+_token_type query_linear(const char *lexeme, _token_group *group)
+{
+	*group = DTYPE;
+
+	for (uint c = 0; c < DATA_TYPE_TABLE_LENGTH; c++)
+	{
+		if (strcmp(lexeme, data_type_table[c].lexeme) == 0)
+			return data_type_table[c].token_type;
+	}
+
+	*group = KEYWORD;
+
+	for (uint c = 0; c < KEYWORD_TABLE_LENGTH; c++)
+	{
+		if (strcmp(lexeme, keyword_table[c].lexeme) == 0)
+			return keyword_table[c].token_type;
+	}
+
+	return is_integer(lexeme) ? INTEGER_LITERAL : IDENTIFIER;
+}
+
+// Words are stored with a '\0' after each, the linear walk needs it
+char* words = NULL;
+uint* word_starts = NULL;
+uint words_counter = 0;
+uint words_size = 0;
+
+void add_word(const char* lexeme, uint length)
+{
+	static uint bytes = 0;
+	static uint bytes_size = 0;
+
+	if (words_counter == words_size)
+	{
+		words_size = words_size * 2 + 1024;
+		word_starts = realloc(word_starts, sizeof(uint) * words_size);
+	}
+
+	if (bytes + length + 1 > bytes_size)
+	{
+		bytes_size = (bytes + length + 1) * 2;
+		words = realloc(words, bytes_size);
+	}
+
+	memcpy(words + bytes, lexeme, length);
+	words[bytes + length] = '\0';
+	word_starts[words_counter++] = bytes;
+	bytes += length + 1;
+}
+
+void read_words(const char* path)
+{
+	uint size = 0;
+	char* source = map_buffer(path, &size);
+
+	if (source == NULL)
+	{
+		fprintf(stderr, "Cannot read %s\n", path);
+		exit(1);
+	}
+
+	for (uint i = 0; i < size;)
+	{
+		uint from = i;
+
+		while (i < size && (isalnum(source[i]) || source[i] == '_' || source[i] == '.'))
+			i++;
+
+		if (i > from)
+			add_word(source + from, i - from);
+		else
+			i++;
+	}
+
+	unmap_buffer(source, size);
+}
+
+void generate_words(uint count)
+{
+	const char* fixed[] = {"i32", "return", "i64", "char", "jump", "INCLUDE", "double", "i1"};
+	char lexeme[16];
+	uint seed = 1;
+
+	for (uint i = 0; i < count; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		uint kind = (seed >> 16) % 10;
+
+		// About half identifiers, a fifth integers and the rest fixed words
+		if (kind < 5)
+		{
+			uint length = 1 + (seed >> 8) % 12;
+
+			for (uint c = 0; c < length; c++)
+			{
+				seed = seed * 1103515245 + 12345;
+				lexeme[c] = "abcdefghijklmnopqrstuvwxyz_0123456789"[c == 0 ? (seed >> 16) % 27 : (seed >> 16) % 37];
+			}
+
+			add_word(lexeme, length);
+		}
+		else if (kind < 7)
+			add_word(lexeme, snprintf(lexeme, sizeof(lexeme), "%u", (seed >> 8) % 100000));
+		else
+			add_word(fixed[(seed >> 8) % 8], strlen(fixed[(seed >> 8) % 8]));
+	}
+}
+
+double elapsed(const struct timespec* from)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - from->tv_sec) * 1e3 + (now.tv_nsec - from->tv_nsec) / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+	uint rounds = argc > 2 ? atoi(argv[2]) : 20;
+
+	if (argc > 1)
+		read_words(argv[1]);
+	else
+		generate_words(1000000);
+
+	if (words_counter == 0 || rounds == 0)
+	{
+		fprintf(stderr, "Nothing to classify\n");
+		return 1;
+	}
+
+	for (uint i = 0; i < words_counter; i++)
+	{
+		const char* lexeme = words + word_starts[i];
+		_token_group hash_group, linear_group;
+		_token_type hash_type = query_word(lexeme, strlen(lexeme), &hash_group);
+		_token_type linear_type = query_linear(lexeme, &linear_group);
+
+		if (hash_type != linear_type || hash_group != linear_group)
+		{
+			fprintf(stderr, "Mismatch on '%s'\n", lexeme);
+			return 1;
+		}
+	}
+
+	// Lengths come from the lexer, so they are not part of the timing
+	uint* lengths = malloc(sizeof(uint) * words_counter);
+
+	for (uint i = 0; i < words_counter; i++)
+		lengths[i] = strlen(words + word_starts[i]);
+
+	uint sink = 0;
+	struct timespec from;
+	_token_group group;
+
+	clock_gettime(CLOCK_MONOTONIC, &from);
+
+	for (uint r = 0; r < rounds; r++)
+		for (uint i = 0; i < words_counter; i++)
+			sink += query_linear(words + word_starts[i], &group) + group;
+
+	double linear_ms = elapsed(&from);
+	clock_gettime(CLOCK_MONOTONIC, &from);
+
+	for (uint r = 0; r < rounds; r++)
+		for (uint i = 0; i < words_counter; i++)
+			sink += query_word(words + word_starts[i], lengths[i], &group) + group;
+
+	double hash_ms = elapsed(&from);
+
+	printf("%u words x %u rounds\n", words_counter, rounds);
+	printf("linear  %8.1f ms  %5.1f ns/word\n", linear_ms, linear_ms * 1e6 / ((double)words_counter * rounds));
+	printf("hash    %8.1f ms  %5.1f ns/word\n", hash_ms, hash_ms * 1e6 / ((double)words_counter * rounds));
+	printf("checksum %u\n", sink);
+
+	free(lengths);
+	return 0;
+}
@@ -22,6 +22,7 @@
 #include "common.h"
 #include "parser.h"
 #include "diagnostic.h"
+#include "preprocessor/preprocessor.h"
 
 AST* var_buffer;
 uint var_counter = 0;
@@ -38,16 +39,15 @@ int definiton_control(const char* type, const AST current)
 	{
 		for (uint i = 0; i < var_counter; i++)
 		{
-			if (strcmp(current.var.name, var_buffer[i].var.name) == 0 && 
-				(strcmp(current.scope, var_buffer[i].scope) == 0 || 
-				strcmp(var_buffer[i].scope, "global") == 0))
+			if (current.var.name == var_buffer[i].var.name && 
+				(current.scope == var_buffer[i].scope || var_buffer[i].scope == global_scope))
 				return i;
 		}
 
 		for (uint i = 0; i < function_counter; i++)
 		{
-			if (strcmp(current.var.name, function_buffer[i].function.name) == 0 &&
-				strcmp(current.scope, "global") == 0)
+			if (current.var.name == function_buffer[i].function.name &&
+				current.scope == global_scope)
 				return i;
 		}
 	}
@@ -56,15 +56,14 @@ int definiton_control(const char* type, const AST current)
 	{
 		for (uint i = 0; i < function_counter; i++)
 		{
-			if (strcmp(current.function.name, 
-				function_buffer[i].function.name) == 0)
+			if (current.function.name == function_buffer[i].function.name)
 				return i;
 		}
 
 		for (uint i = 0; i < var_counter; i++)
 		{
-			if (strcmp(current.function.name, var_buffer[i].var.name) == 0 &&
-				strcmp(var_buffer[i].scope, "global") == 0)
+			if (current.function.name == var_buffer[i].var.name &&
+				var_buffer[i].scope == global_scope)
 				return i;
 		}
 	}
@@ -73,8 +72,8 @@ int definiton_control(const char* type, const AST current)
 	{
 		for (uint i = 0; i < label_counter; i++)
 		{
-			if (strcmp(current.label.name, label_buffer[i].label.name) == 0 && 
-				strcmp(current.scope, label_buffer[i].scope) == 0)
+			if (current.label.name == label_buffer[i].label.name && 
+				current.scope == label_buffer[i].scope)
 				return i;
 		}
 	}
@@ -98,31 +97,31 @@ int is_int(const char* dt)
 	return 0;
 }
 
-void expr_control(AST ast_root, const char* data_type, EXPR* e)
+void expr_control(AST ast_root, const char* data_type, expr_id e)
 {
 	AST ref;
 	int index;
 	
-    switch (e->type)
+    switch (expr_type(e))
     {
         case NODE_INT_LITERAL:
             if (is_int(data_type) < 1)
             {
-           		semantic_error(diagnostic_srcfile, ast_root.line,  ast_root.column,
-           			ast_root.scope, ast_root.scpline, ast_root.scpcolumn, NULL, TYPE_ERROR);	
+           		semantic_error(diagnostic_srcfile, ast_root.position,
+           			ast_root.scope, ast_root.scope_position, NULL, TYPE_ERROR);	
             }
 
             break;
         case NODE_IDENTIFIER:
-        	if (strcmp(ast_root.scope, "global") == 0)
+        	if (ast_root.scope == global_scope)
         	{
-        		semantic_error(diagnostic_srcfile, ast_root.line, ast_root.column,
-					ast_root.scope, ast_root.scpline, ast_root.scpcolumn,
+        		semantic_error(diagnostic_srcfile, ast_root.position,
+					ast_root.scope, ast_root.scope_position,
 					ast_root.label.name, WITHOUT_FUNCTION);
         	}
 
         	ref.scope = ast_root.scope;
-        	ref.var.name = e->identifier;
+        	ref.var.name = expr_text[e];
 			index = definiton_control("var", ref);
 
 			if (index > -1)
@@ -132,71 +131,71 @@ void expr_control(AST ast_root, const char* data_type, EXPR* e)
 					break;
 
 				// Identifier type controls
-				if (strcmp(var_buffer[index].var.type, data_type) != 0)
+				if (var_buffer[index].var.type != data_type)
 				{
-					semantic_error(diagnostic_srcfile, ast_root.line,  ast_root.column, 
-						ast_root.scope, ast_root.scpline, ast_root.scpcolumn,
-						e->identifier, TYPE_ERROR);
+					semantic_error(diagnostic_srcfile, ast_root.position, 
+						ast_root.scope, ast_root.scope_position,
+						expr_text[e], TYPE_ERROR);
 				}
 
 				break;
 			}
 
-			semantic_error(diagnostic_srcfile, ast_root.line, ast_root.column, 
-				ast_root.scope, ast_root.scpline, ast_root.scpcolumn,
-				e->identifier, UNDEFINED);
+			semantic_error(diagnostic_srcfile, ast_root.position, 
+				ast_root.scope, ast_root.scope_position,
+				expr_text[e], UNDEFINED);
         case NODE_BINARY:
         	if (is_int(data_type) < 1)
         	{
-           		semantic_error(diagnostic_srcfile, ast_root.line,  ast_root.column, 
-					ast_root.scope, ast_root.scpline, ast_root.scpcolumn,
+           		semantic_error(diagnostic_srcfile, ast_root.position, 
+					ast_root.scope, ast_root.scope_position,
 					NULL, TYPE_ERROR);
         	}
 
-            expr_control(ast_root, data_type, e->binary.left);
-            expr_control(ast_root, data_type, e->binary.right);
+            expr_control(ast_root, data_type, expr_left[e]);
+            expr_control(ast_root, data_type, expr_right[e]);
             break;
         case NODE_UNARY:
         	if (is_int(data_type) < 1)
         	{
-        		semantic_error(diagnostic_srcfile, ast_root.line,  ast_root.column, 
-					ast_root.scope, ast_root.scpline, ast_root.scpcolumn,
+        		semantic_error(diagnostic_srcfile, ast_root.position, 
+					ast_root.scope, ast_root.scope_position,
 					NULL, TYPE_ERROR);
         	}
 
-            expr_control(ast_root, data_type, e->unary.value);
+            expr_control(ast_root, data_type, expr_left[e]);
             break;
 		case NODE_CALL:
-			if (strcmp(ast_root.scope, "global") == 0)
+			if (ast_root.scope == global_scope)
 			{
-				semantic_error(diagnostic_srcfile, ast_root.line, ast_root.column,
-					ast_root.scope, ast_root.scpline, ast_root.scpcolumn,
+				semantic_error(diagnostic_srcfile, ast_root.position,
+					ast_root.scope, ast_root.scope_position,
 					ast_root.label.name, WITHOUT_FUNCTION);
 			}
 
 			ref.scope = ast_root.scope;
-			ref.function.name = e->call.callee;
+			ref.function.name = expr_text[e];
 			index = definiton_control("function", ref);
 
             if (index > -1)
             {
             	// Args type control
-            	if (function_buffer[index].function.argc != e->call.argc)
+            	if (function_buffer[index].function.argc != expr_right[e])
             	{
-            		semantic_error(diagnostic_srcfile, ast_root.line, ast_root.column,
-						ast_root.scope, ast_root.scpline, ast_root.scpcolumn, 
+            		semantic_error(diagnostic_srcfile, ast_root.position,
+						ast_root.scope, ast_root.scope_position, 
 						NULL, ARGC_MISSMATCH);
             	}
 
-            	if (e->call.argc == 0)
+            	if (expr_right[e] == 0)
             		break;
 
-            	for (uint i = 0; i < e->call.argc; i++)
+            	for (uint i = 0; i < expr_right[e]; i++)
             	{
-            		if (e->call.args[i] != NULL)
+            		if (expr_item(expr_left[e], i) != NO_EXPR)
             		{
             			expr_control(ast_root, function_buffer[index].function.args[i].type, 
-							e->call.args[i]);
+							expr_item(expr_left[e], i));
             		}
             	}
 
@@ -204,19 +203,19 @@ void expr_control(AST ast_root, const char* data_type, EXPR* e)
             	if (is_int(function_buffer[index].function.type) && is_int(data_type))
             		break;
 
-            	if (strcmp(function_buffer[index].function.type, data_type) != 0)
+            	if (function_buffer[index].function.type != data_type)
             	{
-            		semantic_error(diagnostic_srcfile, ast_root.line,  ast_root.column,
-						ast_root.scope, ast_root.scpline, ast_root.scpcolumn,
-						e->identifier, TYPE_ERROR);
+            		semantic_error(diagnostic_srcfile, ast_root.position,
+						ast_root.scope, ast_root.scope_position,
+						expr_text[e], TYPE_ERROR);
             	}
 
             	break;
             }
 
-			semantic_error(diagnostic_srcfile, ast_root.line, ast_root.column,
-				ast_root.scope, ast_root.scpline, ast_root.scpcolumn,
-				e->identifier, UNDEFINED);
+			semantic_error(diagnostic_srcfile, ast_root.position,
+				ast_root.scope, ast_root.scope_position,
+				expr_text[e], UNDEFINED);
         default:
     }
 }
@@ -235,26 +234,26 @@ void semantic_main()
 		switch (ast[i].type)
 		{
 			case INCLUDE:
-				if (read_f(ast[i].include.lib) < 0)
+				if (include_resolve(ast[i].include.lib) == NULL)
 				{
-					semantic_error(diagnostic_srcfile, ast[i].line, ast[i].column,
-						ast[i].scope, ast[i].scpline, ast[i].scpcolumn,
+					semantic_error(diagnostic_srcfile, ast[i].position,
+						ast[i].scope, ast[i].scope_position,
 						ast[i].label.name, FILE_NOT_OPEN);
 				}
 
 				break;
 			case LABEL:
-				if (strcmp(ast[i].scope, "global") == 0)
+				if (ast[i].scope == global_scope)
 				{
-					semantic_error(diagnostic_srcfile, ast[i].line, ast[i].column,
-						ast[i].scope, ast[i].scpline, ast[i].scpcolumn,
+					semantic_error(diagnostic_srcfile, ast[i].position,
+						ast[i].scope, ast[i].scope_position,
 						ast[i].label.name, WITHOUT_FUNCTION);
 				}
 
 				if (definiton_control("label", ast[i]) > -1)
 				{
-					semantic_error(diagnostic_srcfile, ast[i].line, ast[i].column, 
-						ast[i].scope, ast[i].scpline, ast[i].scpcolumn,
+					semantic_error(diagnostic_srcfile, ast[i].position, 
+						ast[i].scope, ast[i].scope_position,
 						ast[i].label.name, REDEFINITION);
 				}
 
@@ -263,14 +262,14 @@ void semantic_main()
 				label_buffer = realloc(label_buffer, sizeof(AST) * label_counter * 2);
 				break;
 			case JUMPER:
-				if (strcmp(ast[i].scope, "global") == 0)
+				if (ast[i].scope == global_scope)
 				{
-					semantic_error(diagnostic_srcfile, ast[i].line, ast[i].column,
-						ast[i].scope, ast[i].scpline, ast[i].scpcolumn,
+					semantic_error(diagnostic_srcfile, ast[i].position,
+						ast[i].scope, ast[i].scope_position,
 						ast[i].label.name, WITHOUT_FUNCTION);
 				}
 
-				expr_control(ast[i], "integer", ast[i].jumper.condition);
+				expr_control(ast[i], intern("integer"), ast[i].jumper.condition);
 				AST jumper_ref;
 				jumper_ref.label.name = ast[i].jumper.label;
 				jumper_ref.scope = ast[i].scope;
@@ -280,13 +279,13 @@ void semantic_main()
 
 				for (uint c = i;;c++)
 				{
-					if (ast[c].type == LABEL && strcmp(ast[c].label.name, ast[i].jumper.label) == 0)
+					if (ast[c].type == LABEL && ast[c].label.name == ast[i].jumper.label)
 						break;
 
-					if(!(c < ast_counter) || strcmp(ast[c].scope, ast[i].scope) != 0)
+					if(!(c < ast_counter) || ast[c].scope != ast[i].scope)
 					{
-						semantic_error(diagnostic_srcfile, ast[i].line, ast[i].column,
-							ast[i].scope, ast[i].scpline, ast[i].scpcolumn,
+						semantic_error(diagnostic_srcfile, ast[i].position,
+							ast[i].scope, ast[i].scope_position,
 							ast[i].label.name, UNDEFINED);
 					}
 				}
@@ -296,12 +295,12 @@ void semantic_main()
 			case VAR:
 				if (definiton_control("var", ast[i]) > -1)
 				{
-					semantic_error(diagnostic_srcfile, ast[i].line, ast[i].column, 
-						ast[i].scope, ast[i].scpline, ast[i].scpcolumn,
+					semantic_error(diagnostic_srcfile, ast[i].position, 
+						ast[i].scope, ast[i].scope_position,
 						ast[i].var.name, REDEFINITION);
 				}
 
-				if (ast[i].var.value != NULL)
+				if (ast[i].var.value != NO_EXPR)
 					expr_control(ast[i], ast[i].var.type, ast[i].var.value);
 
 				var_buffer[var_counter] = ast[i];
@@ -311,8 +310,8 @@ void semantic_main()
 			case FUNCTION:
 				if (definiton_control("function", ast[i]) > -1)
 				{
-					semantic_error(diagnostic_srcfile, ast[i].line, ast[i].column, 
-						ast[i].scope, ast[i].scpline, ast[i].scpcolumn,
+					semantic_error(diagnostic_srcfile, ast[i].position, 
+						ast[i].scope, ast[i].scope_position,
 						ast[i].function.name, REDEFINITION);
 				}
 
@@ -328,8 +327,8 @@ void semantic_main()
 
 					if (definiton_control("var", function_ref) > -1)
 					{
-						semantic_error(diagnostic_srcfile, ast[i].line, ast[i].column, 
-							ast[i].scope, ast[i].scpline, ast[i].scpcolumn,
+						semantic_error(diagnostic_srcfile, ast[i].position, 
+							ast[i].scope, ast[i].scope_position,
 							ast[i].var.name, REDEFINITION);
 					}
 
@@ -343,10 +342,10 @@ void semantic_main()
 				function_buffer = realloc(function_buffer, sizeof(AST) * function_counter * 2);
 				break;
 			case RETURN:
-				if (strcmp(ast[i].scope, "global") == 0)
+				if (ast[i].scope == global_scope)
 				{
-					semantic_error(diagnostic_srcfile, ast[i].line, ast[i].column, 
-						ast[i].scope, ast[i].scpline, ast[i].scpcolumn,
+					semantic_error(diagnostic_srcfile, ast[i].position, 
+						ast[i].scope, ast[i].scope_position,
 						ast[i].label.name, WITHOUT_FUNCTION);
 				}
 
@@ -355,15 +354,15 @@ void semantic_main()
 				char* return_type = function_buffer
 					[definiton_control("function", return_ref)].function.type;
 
-				if (ast[i]._return.value != NULL)
+				if (ast[i]._return.value != NO_EXPR)
 					expr_control(ast[i], return_type, ast[i]._return.value);
 
 				break;
 			case PARSE_ASSIGNMENT:
-				if (strcmp(ast[i].scope, "global") == 0)
+				if (ast[i].scope == global_scope)
 				{
-					semantic_error(diagnostic_srcfile, ast[i].line, ast[i].column, 
-						ast[i].scope, ast[i].scpline, ast[i].scpcolumn,
+					semantic_error(diagnostic_srcfile, ast[i].position, 
+						ast[i].scope, ast[i].scope_position,
 						ast[i].label.name, WITHOUT_FUNCTION);
 				}
 
@@ -380,8 +379,8 @@ void semantic_main()
 
 				if (index < 0)
 				{
-					semantic_error(diagnostic_srcfile, ast[i].line, ast[i].column, 
-						ast[i].scope, ast[i].scpline, ast[i].scpcolumn, 
+					semantic_error(diagnostic_srcfile, ast[i].position, 
+						ast[i].scope, ast[i].scope_position, 
 						ast[i].assignment.name, UNDEFINED);
 				}
 
@@ -394,10 +393,10 @@ void semantic_main()
 				expr_control(ast[i], assignment_type, ast[i].assignment.value);
 				break;
 			case CALL:
-				if (strcmp(ast[i].scope, "global") == 0)
+				if (ast[i].scope == global_scope)
 				{
-					semantic_error(diagnostic_srcfile, ast[i].line, ast[i].column, 
-						ast[i].scope, ast[i].scpline, ast[i].scpcolumn,
+					semantic_error(diagnostic_srcfile, ast[i].position, 
+						ast[i].scope, ast[i].scope_position,
 						ast[i].label.name, WITHOUT_FUNCTION);
 				}
 
@@ -407,15 +406,15 @@ void semantic_main()
 
 				if (index < 0)
 				{
-					semantic_error(diagnostic_srcfile, ast[i].line, ast[i].column, 
-						ast[i].scope, ast[i].scpline, ast[i].scpcolumn, 
+					semantic_error(diagnostic_srcfile, ast[i].position, 
+						ast[i].scope, ast[i].scope_position, 
 						ast[i].call.callee, UNDEFINED);
 				}
 
 				if (function_buffer[index].function.argc != ast[i].call.argc)
 				{
-					semantic_error(diagnostic_srcfile, ast[i].line, ast[i].column,
-						ast[i].scope, ast[i].scpline, ast[i].scpcolumn, 
+					semantic_error(diagnostic_srcfile, ast[i].position,
+						ast[i].scope, ast[i].scope_position, 
 						NULL, ARGC_MISSMATCH);
 				}
 
@@ -427,8 +426,8 @@ void semantic_main()
 				{
 					const char* type = function_buffer[index].function.args[c].type;
 
-					if (ast[i].call.args[c]->identifier != NULL)
-						expr_control(ast[i], type, ast[i].call.args[c]);
+					if (expr_text[expr_item(ast[i].call.args, c)] != NULL)
+						expr_control(ast[i], type, expr_item(ast[i].call.args, c));
 				}
 			default:
 		}
@@ -436,7 +435,7 @@ void semantic_main()
 
 	if (!main_key)
 	{
-		semantic_error(diagnostic_srcfile, 0, 0, 0, 0, 0, 
+		semantic_error(diagnostic_srcfile, NO_POSITION, NULL, NO_POSITION,
 			NULL, MAIN_FUNC_NOT_EXISTS);
 	}
 }
@@ -6,13 +6,16 @@
 
 void print_tokens(uint ex)
 {
-	for (uint i = 0; i < tokens_counter; i++)
+	for (uint i = 0; token_has(i); i++)
 	{
-		printf("%d %s line->%d column->%d\n",
+		const source_position position = position_at(token_pos(i));
+
+		printf("%d %.*s line->%d column->%d\n",
 			i,
-			tokens[i].value,
-			tokens[i].line,
-			tokens[i].column
+			(int)token_at(i)->length,
+			token_text(token_at(i)),
+			position.line,
+			position.column
 		);
 	}
 	
@@ -20,40 +23,40 @@ void print_tokens(uint ex)
 		exit(0);
 }
 
-void print_expr(EXPR* e) 
+void print_expr(expr_id e) 
 {
-    if (!e) 
+    if (e == NO_EXPR) 
     	return;
 
-    switch (e->type)
+    switch (expr_type(e))
     {
         case NODE_INT_LITERAL: 
-            printf("%s", e->literal); 
+            printf("%s", expr_text[e]); 
             break;
         case NODE_IDENTIFIER: 
-            printf("%s", e->identifier); 
+            printf("%s", expr_text[e]); 
             break;
         case NODE_BINARY:
             printf("(");
-            print_expr(e->binary.left);
-            printf(" %s ", e->binary.op);
-            print_expr(e->binary.right);
+            print_expr(expr_left[e]);
+            printf(" %s ", expr_text[e]);
+            print_expr(expr_right[e]);
             printf(")");
             break;
         case NODE_UNARY:
-            printf("(%s", e->unary.op);
-            print_expr(e->unary.value);
+            printf("(%s", expr_text[e]);
+            print_expr(expr_left[e]);
             printf(")");
             break;
 		case NODE_CALL:
             printf("(");
-            printf("call>%s ", e->call.callee);
+            printf("call>%s ", expr_text[e]);
 	
-            for (uint i = 0; i < e->call.argc; i++)
+            for (uint i = 0; i < expr_right[e]; i++)
             {
-            	print_expr(e->call.args[i]);
+            	print_expr(expr_item(expr_left[e], i));
 
-            	if (i + 1 != e->call.argc)
+            	if (i + 1 != expr_right[e])
             		printf(",");
             }
 
@@ -61,13 +64,13 @@ void print_expr(EXPR* e)
             break;
 		case NODE_ARRAY:
             printf("(");
-            printf("dim>%s ", e->array.name);
+            printf("dim>%s ", expr_text[e]);
 
-            for (uint i = 0; i < e->array.dimc; i++)
+            for (uint i = 0; i < expr_right[e]; i++)
             {
-            	print_expr(e->array.dims[i]);
+            	print_expr(expr_item(expr_left[e], i));
 
-            	if (i + 1 != e->array.dimc)
+            	if (i + 1 != expr_right[e])
             		printf(", ");
             }
 
@@ -107,7 +110,7 @@ void print_ast(uint ex)
 				for (uint j = 0; j < ast[i].call.argc; j++)
 				{
 					printf("		ARG %d ", j);
-					print_expr(ast[i].call.args[j]);
+					print_expr(expr_item(ast[i].call.args, j));
 					printf("\n");
 				}
 
@@ -118,13 +121,13 @@ void print_ast(uint ex)
 				printf("	->VAR NAME; %s\n", ast[i].var.name);
 				printf("	->VAR VALUE; "); 
 
-				if(ast[i].var.value != NULL)
+				if(ast[i].var.value != NO_EXPR)
 					print_expr(ast[i].var.value);
 
 				printf("\n	->DIMS; (");
 				for (uint c = 0; c < ast[i].var.dimc; c++)
 				{
-					print_expr(ast[i].var.dims[c]);
+					print_expr(expr_item(ast[i].var.dims, c));
 
 					if (c + 1 != ast[i].var.dimc)
 						printf(", ");
@@ -138,13 +141,13 @@ void print_ast(uint ex)
 				printf("	->VAR NAME; %s\n", ast[i].var.name);
 				printf("	->VAR VALUE; ");
 
-				if(ast[i].var.value != NULL)
+				if(ast[i].var.value != NO_EXPR)
 					print_expr(ast[i].var.value);
 
 				printf("\n	->DIMS; (");
 				for (uint c = 0; c < ast[i].var.dimc; c++)
 				{
-					print_expr(ast[i].var.dims[c]);
+					print_expr(expr_item(ast[i].var.dims, c));
 
 					if (c + 1 != ast[i].var.dimc)
 						printf(", ");
@@ -161,7 +164,7 @@ void print_ast(uint ex)
 				printf("\n	->DIMS; (");
 				for (uint c = 0; c < ast[i].assignment.dimc; c++)
 				{
-					print_expr(ast[i].assignment.dims[c]);
+					print_expr(expr_item(ast[i].assignment.dims, c));
 
 					if (c + 1 != ast[i].assignment.dimc) 
 						printf(", ");
@@ -0,0 +1,31 @@
+#!/bin/sh
+# A cached unit must not be reused once a new file shadows one of its
+# includes on the search path. Usage: test/include_shadow.sh [bin/seal]
+
+seal=$(realpath "${1:-bin/seal}")
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+
+mkdir lib
+printf 'i32 libval = 1;\n@\n' > lib/x.seal
+printf 'INCLUDE "x.seal"\n\n# i32 main()\n{\n    return 0;\n}\n' > main.seal
+
+"$seal" -c main.seal -I lib --cache-dir cache -s ir > /dev/null 2>&1
+
+if ! grep -q libval sealir.sir; then
+	echo "FAIL: lib/x.seal was not included"
+	exit 1
+fi
+
+# ./x.seal comes before the -I paths
+printf 'i32 localval = 2;\n@\n' > x.seal
+rm sealir.sir
+"$seal" -c main.seal -I lib --cache-dir cache -s ir > /dev/null 2>&1
+
+if ! grep -q localval sealir.sir || grep -q libval sealir.sir; then
+	echo "FAIL: stale cache entry used after x.seal was shadowed"
+	exit 1
+fi
+
+echo "PASS"